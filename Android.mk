@@ -5,13 +5,17 @@ LOCAL_PATH:= $(call my-dir)
 #
 include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
+	src/activity.cc \
+	src/arena.cc \
 	src/area.cc \
 	src/c-api.cc \
 	src/engine.cc \
 	src/flush.cc \
 	src/format-basic.cc \
 	src/format-raw.cc \
+	src/futex.cc \
 	src/internal.cc \
+	src/limiter.cc \
 	src/mask.cc \
 	src/schedparam.cc \
 	src/ostrbuf.cc \
@@ -25,13 +29,18 @@ LOCAL_SRC_FILES := \
 	src/output-stdout.cc \
 	src/output-plainfile.cc \
 	src/output-tee.cc \
+	src/overlay.cc \
+	src/percpu.cc \
 	src/platform.cc \
 	src/post.cc \
 	src/ringbuf.cc \
+	src/ringmem.cc \
+	src/strcopy.cc \
 	src/timesource.cc \
 	src/tls.cc \
 	src/default-ringopts.cc \
 	src/default-timesource.cc \
+	src/tsc-timesource.cc \
 	src/default-engine.cc \
 	src/fmt-format.cc
 
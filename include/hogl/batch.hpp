@@ -0,0 +1,182 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/batch.hpp
+ * Batch API for posting many log records at once.
+ */
+#ifndef HOGL_BATCH_HPP
+#define HOGL_BATCH_HPP
+
+#include <stdint.h>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/preproc.hpp>
+#include <hogl/detail/area.hpp>
+#include <hogl/detail/post.hpp>
+#include <hogl/post.hpp>
+#include <hogl/tls.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Batch of log records.
+ * Reserves room for several records at once, fills them in and publishes
+ * them with a single tail update (one write barrier) when the batch is 
+ * committed. Records can optionally share a single timestamp, the sequence 
+ * numbers keep them in order.
+ * Shared rings stay locked for the lifetime of the batch. Batches must be
+ * short lived and the same ring must not be posted into by other means 
+ * while the batch is active.
+ * If the reserved room runs out the batch commits what it has and reserves
+ * some more. If the ring is full records are pushed (dropped, blocked on, etc) 
+ * one by one just like hogl::post() does.
+ */
+class batch {
+private:
+	ringbuf     *_ring;
+	unsigned int _want;   // Number of records to reserve room for
+	unsigned int _avail;  // Number of reserved records
+	unsigned int _count;  // Number of filled records
+	bool         _shared_ts;
+	hogl::timestamp _timestamp;
+
+	void reserve()
+	{
+		flush();
+		_avail = _ring->push_reserve(_want);
+	}
+
+	void flush()
+	{
+		if (_count) {
+			_ring->push_commit_batch(_count);
+			_avail -= _count;
+			_count  = 0;
+		}
+	}
+
+	record *begin(const hogl::area *area, unsigned int sect)
+	{
+		if (hogl_unlikely(_count == _avail))
+			reserve();
+		record *r = _ring->push_begin(_count);
+		r->seqnum    = _ring->inc_seqnum();
+		r->timestamp = _shared_ts ? _timestamp : _ring->timestamp();
+		r->area      = area;
+		r->section   = sect;
+		return r;
+	}
+
+	void finish()
+	{
+		// Out of reserved room. Single record path takes care
+		// of the full rings.
+		if (hogl_likely(_count < _avail))
+			_count++;
+		else
+			_ring->push_commit();
+	}
+
+	bool enabled(const hogl::area *area, unsigned int sect)
+	{
+		return (area->test(sect) || (hogl_unlikely(_ring->overlay() != 0) && post_impl::overlaid(_ring, area, sect))) &&
+			(hogl_likely(!area->limited(sect)) || post_impl::admit_unlocked(_ring, area, sect));
+	}
+
+	batch(const batch &);
+	batch& operator=(const batch &);
+
+public:
+	/**
+	 * Start a batch
+	 * @param ring ring to post the records into
+	 * @param n number of records to reserve room for
+	 * @param shared_timestamp all records get the timestamp taken when the batch is started
+	 */
+	batch(ringbuf *ring, unsigned int n, bool shared_timestamp = false) :
+		_ring(ring), _want(n ? n : 1), _avail(0), _count(0), _shared_ts(shared_timestamp)
+	{
+		_ring->lock();
+		if (_shared_ts)
+			_timestamp = _ring->timestamp();
+	}
+
+	/**
+	 * Start a batch in the TLS ring
+	 * @param n number of records to reserve room for
+	 * @param shared_timestamp all records get the timestamp taken when the batch is started
+	 */
+	explicit batch(unsigned int n, bool shared_timestamp = false) :
+		batch(tls::ring(), n, shared_timestamp)
+	{ }
+
+	/**
+	 * Commit the batch
+	 */
+	~batch()
+	{
+		commit();
+	}
+
+	/**
+	 * Publish all records posted so far.
+	 * The batch is finished and must not be used after this.
+	 */
+	void commit()
+	{
+		if (!_ring)
+			return;
+		flush();
+		_ring->unlock();
+		_ring = 0;
+	}
+
+	/**
+	 * Get number of records posted but not yet published
+	 */
+	unsigned int pending() const { return _count; }
+
+	/**
+	 * Post new log record into the batch
+	 */
+	template<typename... A>
+	hogl_force_inline void post(const hogl::area *area, unsigned int sect, const A&... a)
+	{
+		if (enabled(area, sect)) {
+			record *r = begin(area, sect);
+			r->set_args(_ring->record_tailroom(), a...);
+			finish();
+		} else
+			skip(_ring, area, sect, a...);
+	}
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_BATCH_HPP
@@ -63,6 +63,12 @@ enum hogl_arg_type {
 	HOGL_ARG_RAW,    // Raw data
 };
 
+/**
+ * Length of the strings that are not known at compile time.
+ * Those are measured while copying into the record.
+ */
+#define HOGL_ARG_UNKNOWN_LEN 0xffffffff
+
 /**
  * Record argument.
  * Used internaly by the library.
@@ -59,7 +59,7 @@
 static inline void __hogl_strarg(struct hogl_arg *arg, const char *str)
 {
 	arg->type = HOGL_ARG_CSTR;
-	arg->len  = strlen(str);
+	arg->len  = __builtin_constant_p(strlen(str)) ? strlen(str) : HOGL_ARG_UNKNOWN_LEN;
 	arg->val  = (unsigned long) str;
 }
 
@@ -0,0 +1,208 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/activity.hpp
+ * Ring activity bitmap.
+ */
+#ifndef HOGL_DETAIL_ACTIVITY_HPP
+#define HOGL_DETAIL_ACTIVITY_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/barrier.hpp>
+#include <hogl/detail/futex.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Ring activity bitmap.
+ * Each ring in the engine index owns a slot (bit). Writers set the bit
+ * when they commit records and the engine takes (clears) whole words to
+ * find out which rings need to be visited.
+ * Bits are packed into cache-line sized lines which are allocated in
+ * segments. Segments are never moved or freed while the bitmap is alive,
+ * so writers can set bits without any locking.
+ * Slot allocation is done by the engine thread only.
+ * Writers that need the engine right away (blocked on a full ring,
+ * waiting for a flush) can also wake it up, and wait for the engine
+ * to acknowledge their special records.
+ */
+class activity {
+public:
+	enum {
+		WORD_BITS  = 64,
+		LINE_WORDS = 8,
+		LINE_BITS  = LINE_WORDS * WORD_BITS,
+		SEG_LINES  = 64,
+		SEG_BITS   = SEG_LINES * LINE_BITS,
+		MAX_SEGS   = 64
+	};
+
+	enum { NOSLOT = ~0u };
+
+	activity();
+	~activity();
+
+	/**
+	 * Mark the slot as active. Writer's interface.
+	 * Atomic op is issued only if the bit is not already set.
+	 * The barrier orders the writer's tail update before the bit test.
+	 * Otherwise the test can see the bit that the reader is about to take,
+	 * and the reader then misses the new tail.
+	 */
+	void mark(unsigned int slot)
+	{
+		volatile uint64_t *w = word(slot);
+		uint64_t b = 1ULL << (slot % WORD_BITS);
+		barrier::memrw();
+		if (!(*w & b))
+			__sync_fetch_and_or(w, b);
+	}
+
+	/**
+	 * Take and clear the word with the specified index.
+	 * Reader's interface.
+	 */
+	uint64_t take(unsigned int i)
+	{
+		volatile uint64_t *w = word(i * WORD_BITS);
+		if (!*w)
+			return 0;
+		return __sync_fetch_and_and(w, 0);
+	}
+
+	/**
+	 * Wake up the reader. Writer's interface.
+	 * Syscall is made only if the reader is sleeping.
+	 */
+	void wake()
+	{
+		__sync_fetch_and_add(&_wake_seq, 1);
+		if (_sleeping)
+			futex::wake(&_wake_seq, 1);
+	}
+
+	/**
+	 * Get wakeup sequence number. Reader's interface.
+	 * Must be taken before the reader checks for work.
+	 */
+	int wake_seq() const { return _wake_seq; }
+
+	/**
+	 * Sleep until timeout or until a writer calls wake().
+	 * Reader's interface. Returns right away if wake() was called
+	 * since the sequence number was taken.
+	 * @param seq sequence number returned by wake_seq()
+	 * @param usec timeout in microseconds
+	 */
+	void sleep(int seq, unsigned int usec);
+
+	/**
+	 * Get ack sequence number. Writer's interface.
+	 * Must be taken before checking if the record was acked.
+	 */
+	int ack_seq() const { return _ack_seq; }
+
+	/**
+	 * Register (+1) or unregister (-1) a writer waiting for acks. Writer's interface.
+	 */
+	void ack_waiter(int n) { __sync_fetch_and_add(&_ack_waiters, n); }
+
+	/**
+	 * Check if any writers are waiting for acks. Reader's interface.
+	 */
+	bool ack_waiters() const { return _ack_waiters; }
+
+	/**
+	 * Wait until the reader acks more records or timeout. Writer's interface.
+	 * Returns right away if records were acked since the sequence number was taken.
+	 * @param seq sequence number returned by ack_seq()
+	 * @param usec timeout in microseconds
+	 */
+	void wait_ack(int seq, unsigned int usec)
+	{
+		futex::wait(&_ack_seq, seq, usec);
+	}
+
+	/**
+	 * Wake up writers waiting for acks. Reader's interface.
+	 * Must be called after acking the records.
+	 */
+	void signal_acks()
+	{
+		__sync_fetch_and_add(&_ack_seq, 1);
+		if (_ack_waiters)
+			futex::wake(&_ack_seq);
+	}
+
+	/**
+	 * Number of words that may have bits set
+	 */
+	unsigned int words() const { return (_nslots + WORD_BITS - 1) / WORD_BITS; }
+
+	/**
+	 * Allocate a slot.
+	 * @return slot number or NOSLOT if the bitmap is full
+	 */
+	unsigned int alloc();
+
+	/**
+	 * Free the slot.
+	 */
+	void free(unsigned int slot);
+
+private:
+	struct line {
+		volatile uint64_t word[LINE_WORDS];
+	} __attribute__ ((aligned(64)));
+
+	line        *_seg[MAX_SEGS];
+	unsigned int _nslots; // Slot high-water mark
+	volatile int _wake_seq;
+	volatile int _sleeping;
+	volatile int _ack_seq;
+	volatile int _ack_waiters;
+	std::vector<unsigned int> _free;
+
+	volatile uint64_t *word(unsigned int slot)
+	{
+		line *l = &_seg[slot / SEG_BITS][(slot % SEG_BITS) / LINE_BITS];
+		return &l->word[(slot % LINE_BITS) / WORD_BITS];
+	}
+
+	// No copies
+	activity(const activity&);
+	activity& operator=(const activity&);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_ACTIVITY_HPP
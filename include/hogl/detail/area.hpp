@@ -51,12 +51,35 @@ namespace hogl {
  * or clear section bits. size() or count() returns number of sections.
  */
 class area {
+public:
+	/**
+	 * Section rate limit.
+	 * Records that exceed the limit are suppressed by the post path.
+	 */
+	struct limit {
+		uint32_t rate;   /// Max number of records per second (0 - no limit)
+		uint32_t sample; /// Only one in N records is posted (0 or 1 - no sampling)
+
+		bool active() const { return rate || sample > 1; }
+	};
+
 protected:
 	magic          _magic;   /// Magic number 
 	char          *_name;    /// Area name
 	const char   **_section; /// Section names
 	bitmap _bitmap;  /// Bitmap (one bit per section)
 
+	// Pre-rendered "AREA:SECTION " strings (one per section, back to back)
+	// and their offsets. Used by the formatters to avoid strlen() calls.
+	unsigned int   _name_len;    /// Area name length
+	char          *_prefix;      /// Prefix strings
+	unsigned int  *_prefix_off;  /// Prefix offsets (size + 1 entries)
+
+	bitmap _limited; /// Bitmap of rate limited sections
+	limit *_limit;   /// Section rate limits (allocated on first use)
+
+	bitmap _critical; /// Bitmap of critical sections (may use reserved ring room)
+
 public:
 	/**
 	 * Default section IDs
@@ -85,6 +108,12 @@ public:
  	 */
 	const char *name() const { return _name; }
 
+	/**
+ 	 * Get area name length
+ 	 * @return area name length
+ 	 */
+	unsigned int name_len() const { return _name_len; }
+
 	/**
  	 * Get section names
  	 * @return pointer to an array of section names
@@ -96,6 +125,31 @@ public:
 		return _section[i];
 	}
 
+	/**
+ 	 * Get section name length
+ 	 * @return section name length
+ 	 */
+	unsigned int section_name_len(unsigned int i) const
+	{
+		if (i >= _bitmap.size())
+			return sizeof("INVALID") - 1;
+		return _prefix_off[i + 1] - _prefix_off[i] - _name_len - 2;
+	}
+
+	/**
+ 	 * Get pre-rendered "AREA:SECTION " string.
+ 	 * @param i section number
+ 	 * @param len reference to the length of the string (not null terminated)
+ 	 * @return pointer to the string or null if section number is invalid
+ 	 */
+	const char *section_prefix(unsigned int i, unsigned int &len) const
+	{
+		if (i >= _bitmap.size())
+			return 0;
+		len = _prefix_off[i + 1] - _prefix_off[i];
+		return _prefix + _prefix_off[i];
+	}
+
 	/**
  	 * Get number of sections
  	 * @return number of sections
@@ -118,6 +172,58 @@ public:
 		return _bitmap.test(s);
 	}
 
+	/**
+ 	 * Test if specific section is rate limited.
+ 	 * @param s section number
+ 	 * @return true if section has a rate limit, false otherwise
+ 	 */
+	bool limited(unsigned int s) const
+	{
+		return _limited.test(s);
+	}
+
+	/**
+ 	 * Get section rate limit.
+ 	 * @param s section number
+ 	 * @return rate limit (all zeros if section is not limited)
+ 	 */
+	limit get_limit(unsigned int s) const
+	{
+		if (!_limit || s >= _bitmap.size()) {
+			limit l = { 0, 0 };
+			return l;
+		}
+		return _limit[s];
+	}
+
+	/**
+ 	 * Set section rate limit.
+ 	 * @param s section number
+ 	 * @param l rate limit (all zeros removes the limit)
+ 	 */
+	void set_limit(unsigned int s, const limit &l);
+
+	/**
+ 	 * Test if specific section is critical.
+ 	 * Critical records are allowed to use the room reserved in the ring.
+ 	 * @param s section number
+ 	 * @return true if section is critical, false otherwise
+ 	 */
+	bool critical(unsigned int s) const
+	{
+		return _critical.test(s);
+	}
+
+	/**
+ 	 * Mark section as critical.
+ 	 * @param s section number
+ 	 * @param v critical or not
+ 	 */
+	void set_critical(unsigned int s, bool v = true)
+	{
+		_critical.set(s, v);
+	}
+
 	/**
  	 * Set all section bits to 1 (enable all sections)
  	 */
@@ -178,6 +284,13 @@ public:
 
 	bool operator!=(const area &a) const { return !(*this == a); }
 
+protected:
+	/**
+ 	 * Update cached name lengths and section prefixes.
+ 	 * Must be called if area or section names are modified after construction.
+ 	 */
+	void update_names();
+
 private:
 	// No copies
 	area(const area&);
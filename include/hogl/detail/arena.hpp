@@ -0,0 +1,120 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/arena.hpp
+ * Payload arena.
+ */
+#ifndef HOGL_DETAIL_ARENA_HPP
+#define HOGL_DETAIL_ARENA_HPP
+
+#include <stdint.h>
+
+#include <hogl/detail/compiler.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Payload arena.
+ * Byte ring for the record arguments (strings, raw data, hexdumps) that
+ * do not fit into the record tailroom. Single writer (ring writer), single
+ * reader (engine). Each allocation is tagged with the sequence number of the
+ * record it belongs to. The reader releases the space in order once it is
+ * done with the records.
+ */
+class arena {
+public:
+	/**
+	 * Allocate the arena
+	 * @param size size in bytes (rounded up to power of two). 
+	 *    Check allocated() for the allocation failures.
+	 */
+	explicit arena(unsigned int size);
+	~arena();
+
+	/**
+	 * Check if the arena buffer was allocated
+	 */
+	bool allocated() const { return _buf != 0; }
+
+	/**
+	 * Get arena size in bytes
+	 */
+	unsigned int size() const { return _mask + 1; }
+
+	/**
+	 * Get number of bytes in use
+	 */
+	unsigned int used() const { return _head - _tail; }
+
+	/**
+	 * Allocate space for the argument data. Writer's interface.
+	 * @param seqnum sequence number of the record
+	 * @param len size of the data in bytes
+	 * @return pointer to the data buffer or null if there is no room
+	 */
+	uint8_t *alloc(uint64_t seqnum, unsigned int len);
+
+	/**
+	 * Release the space used by the records. Reader's interface.
+	 * @param seqnum sequence number of the last record the reader is done with
+	 */
+	void release(uint64_t seqnum);
+
+	/**
+	 * Reset the arena (drops everything). 
+	 * Neither reader nor writer must be using the arena.
+	 */
+	void reset() { _head = _tail = 0; }
+
+private:
+	// Chunk header. Chunks are 16 byte aligned, padding at the end
+	// of the buffer is a chunk too.
+	struct chunk {
+		uint64_t seqnum;
+		uint32_t size;
+		uint32_t unused;
+	};
+
+	uint8_t     *_buf;
+	unsigned int _mask;
+
+	// R/W access by the writer
+	volatile unsigned int _head;
+
+	// R/W access by the reader
+	volatile unsigned int _tail;
+
+	// No copies
+	arena(const arena&);
+	arena& operator=(const arena&);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_ARENA_HPP
@@ -35,6 +35,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <hogl/detail/compiler.hpp>
 #include <hogl/detail/args.hpp>
 #include <hogl/detail/preproc.hpp>
 
@@ -42,137 +43,94 @@ __HOGL_PRIV_NS_OPEN__
 namespace hogl {
 
 /**
- * Packed arguments
+ * Packed argument value and length.
+ * Argument types are packed separately, 4-bits per argument (see record::argtype).
  */
-struct argpack {
-	uint64_t argtype;
+struct argpack_item {
 	union {
 		uint64_t u64;
 		uint32_t u32;
-	} argval[16];
-	uint32_t arglen[16];
-
-	/**
-	 * Get number of arguments in the pack
-	 */
-	unsigned int nargs() const
-	{
-		unsigned int n = 0;
-		uint64_t t = argtype;
-		while (t) { t = t >> 4; ++n; }
-		return n;
-	}
-
-	/**
- 	 * Set argument type.
- 	 * @param i index (position) of the argument (zero based)
- 	 * @param type argument type
- 	 */
-	void set_arg_type(unsigned int i, unsigned int type)
-	{
-		argtype |= (uint64_t) (type & 0xf) << (i * 4);
-	}
-
-	/**
- 	 * Get argument type.
- 	 * @param i index (position) of the argument (zero based)
- 	 * @return a argument reference
- 	 */
-	unsigned int get_arg_type(unsigned int i) const
-	{
-		return (argtype >> (i * 4)) & 0xf;
-	}
-
-	/**
- 	 * Get argument 32-bit value 
- 	 * @param i index (position) of the argument (zero based)
- 	 */
-	uint32_t get_arg_val32(unsigned int i) const
-	{
-		return argval[i].u32;
-	}
+	} val;
+	uint32_t len;
 
 	/**
- 	 * Get argument 32-bit value 
- 	 * @param i index (position) of the argument (zero based)
- 	 */
-	uint64_t get_arg_val64(unsigned int i) const
-	{
-		return argval[i].u64;
-	}
-
-	/**
- 	 * Get argument data
- 	 * @param i index (position) of the argument (zero based)
+	 * Get argument data
 	 * @param [out] len size of the data
 	 * @return pointer to the data
- 	 */
-	const uint8_t *get_arg_data(unsigned int i, unsigned int &len) const
+	 */
+	const uint8_t *data(unsigned int &l) const
 	{
-		len = arglen[i];
+		l = len;
 
 		#if ULONG_MAX == UINT_MAX
 		// 32-bit arch
-		return (const uint8_t *) argval[i].u32;
+		return (const uint8_t *) val.u32;
 		#else
 		// 64-bit arch
-		return (const uint8_t *) argval[i].u64;
+		return (const uint8_t *) val.u64;
 		#endif
 	}
+};
+
+/**
+ * Packed arguments.
+ * Exact-size pack used for passing arguments out of line. 
+ * Only the arguments that are actually used take space.
+ * Argument types are returned by populate() and are passed separately
+ * so that they can stay in a register.
+ */
+template<unsigned int N>
+struct argpack {
+	argpack_item item[N ? N : 1];
 
 	/**
  	 * Set argument.
  	 * @param i index (position) of the argument (zero based)
  	 * @param a argument itself
-	 * @param 0 for simple argument and 1 otherwise
+ 	 * @param type packed argument types
  	 */
-	hogl_force_inline unsigned int set_arg(unsigned int i, const hogl::arg a)
+	hogl_force_inline void set_arg(unsigned int i, const hogl::arg a, uint64_t &type)
 	{
 		if (a.type == a.NONE)
-			return 0;
+			return;
 
 		__hogl_check_arg(a);
 
-		set_arg_type(i, a.type);
+		type |= (uint64_t) (a.type & 0xf) << (i * 4);
 
 		if (a.is_32bit())
-			argval[i].u32 = a.val;
+			item[i].val.u32 = a.val;
 		else
-			argval[i].u64 = a.val;
-
-		if (a.is_simple())
-			return 0;
+			item[i].val.u64 = a.val;
 
-		arglen[i] = a.len;
-		return 1;
+		if (!a.is_simple())
+			item[i].len = a.len;
 	}
 
-	/**
- 	 * Populate argpack arguments
- 	 * @param arg0 ... arg1 argument list
-	 * @return number of non-simple arguments
- 	 */
-	hogl_force_inline unsigned int populate(__hogl_long_arg_list(16))
+	// Set arguments starting at index I (compile-time recursion over the argument list)
+	template<unsigned int I>
+	hogl_force_inline void set_args(uint64_t &) { }
+
+	template<unsigned int I, typename A, typename... R>
+	hogl_force_inline void set_args(uint64_t &type, const A &a, const R&... r)
 	{
-		unsigned int n = 0;
-		argtype = 0;
-		#define __hogl_argpack_set_arg(i) n += set_arg(i, a##i)
-		HOGL_PP_REPS(16, __hogl_argpack_set_arg, ;);
-		return n;
+		set_arg(I, hogl::arg(a), type);
+		set_args<I + 1>(type, r...);
 	}
 
 	/**
- 	 * Clear the record.
+ 	 * Populate argpack arguments
+ 	 * @param a argument list (anything hogl::arg can be constructed from)
+ 	 * @return packed argument types (4-bits per argument, see record::argtype)
  	 */
-	void clear()
+	template<typename... A>
+	hogl_force_inline uint64_t populate(const A&... a)
 	{
-		argtype = 0;
+		static_assert(sizeof...(A) <= N, "hogl: too many arguments");
+		uint64_t type = 0;
+		set_args<0>(type, a...);
+		return type;
 	}
-
-	/**
- 	 * Construct new argpack
- 	 */
-	argpack() { clear(); }
 };
 
 } // namespace hogl
@@ -63,6 +63,27 @@ struct arg_raw {
 	hogl_force_inline arg_raw(const void *p, unsigned int n): ptr(p), len(n) {}
 };
 
+/**
+ * Borrowed raw data.
+ * Same as arg_raw except that the data is not copied into the record.
+ * The record holds a reference to the data and the engine formats it straight 
+ * from the original buffer. Release callback is called once the engine is done
+ * with the record (the data is written out or copied into the output buffer).
+ * The buffer must stay valid until then.
+ * Records that are dropped and the rings that cannot keep references 
+ * (see ringbuf::RECORDER) release the data right away.
+ */
+struct arg_borrow {
+	typedef void (*release_fn)(const void *ptr, void *ctx);
+
+	const void  *ptr;
+	unsigned int len;
+	release_fn   release;
+	void        *ctx;
+	hogl_force_inline arg_borrow(const void *p, unsigned int n, release_fn r, void *c = 0):
+		ptr(p), len(n), release(r), ctx(c) {}
+};
+
 /**
  * Formated data dump.
  * Special argument that tells HOGL to store the data as is and
@@ -104,6 +125,7 @@ struct arg {
 		GSTR,   /// Global string (see below)
 		XDUMP,  /// Xdump
 		RAW,    /// Raw data
+		BORROW, /// Borrowed raw data (stored as RAW)
 	};
 
 	// This layout generates the most optimal code.
@@ -113,6 +135,17 @@ struct arg {
 	uint64_t     val;
 	unsigned int len;
 
+	// Length of the strings that are not known at compile time.
+	// Those are measured while copying into the record.
+	static const unsigned int UNKNOWN_LEN = 0xffffffff;
+
+	static hogl_force_inline unsigned int cstr_len(const char *str)
+	{
+		if (!str) return 0;
+		if (__builtin_constant_p(strlen(str))) return strlen(str);
+		return UNKNOWN_LEN;
+	}
+
 #if ULONG_MAX == UINT_MAX
 	// 32bit arch
 	static bool is_32bit(unsigned int type)
@@ -131,7 +164,7 @@ struct arg {
 
 	bool is_simple() const 
 	{
-		return (type != CSTR && type != XDUMP && type != RAW);
+		return (type != CSTR && type != XDUMP && type != RAW && type != BORROW);
 	}
 
 	// Various constructors for autodetecting argument types.
@@ -165,9 +198,10 @@ struct arg {
 		val = u.u;
 	}
 
-	// For static strings the call to strlen() is resolved at compile time
+	// For static strings the call to strlen() is resolved at compile time.
+	// Other strings are scanned only up to the available room (see record::copy_cstr()).
 	hogl_force_inline arg(const char *str) :
-		type(CSTR), val((uint64_t) str), len(str ? strlen(str) : 0) {}
+		type(CSTR), val((uint64_t) str), len(cstr_len(str)) {}
 
 	hogl_force_inline arg(const std::string &str) :
 		type(CSTR), val((uint64_t) str.data()), len(str.length()) {}
@@ -179,12 +213,31 @@ struct arg {
 
 	hogl_force_inline arg(const arg_raw &raw) :
 		type(RAW), val((uint64_t) raw.ptr), len(raw.len) {}
+
+	hogl_force_inline arg(const arg_borrow &b) :
+		type(BORROW), val((uint64_t) &b) {}
 };
 
 // Dummy function to call for triggering VG warnings on uninitialized args.
 // See argpack.hpp
 extern void arg_check(const arg& a);
 
+/**
+ * Compile-time argument traits.
+ * Complex arguments (strings, data dumps, etc) are processed out of line.
+ * Plain hogl::arg is treated as complex because its type is not known 
+ * at compile time. For the same reason it may hold borrowed data.
+ * Borrowed data must be released even if the record is not posted.
+ */
+template<typename T> struct arg_traits    { enum { simple = 1, borrowed = 0 }; };
+template<> struct arg_traits<char *>       { enum { simple = 0, borrowed = 0 }; };
+template<> struct arg_traits<const char *> { enum { simple = 0, borrowed = 0 }; };
+template<> struct arg_traits<std::string>  { enum { simple = 0, borrowed = 0 }; };
+template<> struct arg_traits<arg_xdump>    { enum { simple = 0, borrowed = 0 }; };
+template<> struct arg_traits<arg_raw>      { enum { simple = 0, borrowed = 0 }; };
+template<> struct arg_traits<arg_borrow>   { enum { simple = 0, borrowed = 1 }; };
+template<> struct arg_traits<arg>          { enum { simple = 0, borrowed = 1 }; };
+
 } // namespace hogl
 __HOGL_PRIV_NS_CLOSE__
 
@@ -33,11 +33,15 @@
 
 #include <string>
 #include <map>
+#include <utility>
+#include <vector>
 
 #include <hogl/detail/types.hpp>
 #include <hogl/detail/magic.hpp>
 #include <hogl/detail/ringbuf.hpp>
+#include <hogl/detail/ringmem.hpp>
 #include <hogl/detail/tsobuf.hpp>
+#include <hogl/detail/registry.hpp>
 #include <hogl/detail/format.hpp>
 #include <hogl/detail/output.hpp>
 #include <hogl/detail/area.hpp>
@@ -60,6 +64,13 @@ public:
 		DISABLE_TSO = (1<<0),
 	};
 
+	/**
+	 * Rings are not shrunk below this capacity when memory is short
+	 */
+	enum {
+		MIN_RING_CAPACITY = 64
+	};
+
 	/**
 	 * Engine options.
 	 */
@@ -70,6 +81,12 @@ public:
 		unsigned int features;
 		hogl::schedparam* schedparam;
 		hogl::timesource* timesource;
+		unsigned int unblock_threshold;  // Wake blocked writers after this many records are freed (0 - end of pass)
+		mask         recorder_trigger;   // Sections that trigger flight recorder dumps
+		unsigned int recorder_depth;     // Max number of records dumped from each recorder (0 - all)
+		unsigned int recorder_window_usec; // Max age of the dumped records (0 - unlimited)
+		unsigned int ring_pool_size;     // Max number of orphaned rings kept for reuse (0 - no pool)
+		unsigned long ring_memory_limit; // Max number of bytes for the ring record buffers (0 - unlimited)
 	};
 
 	static options default_options;
@@ -81,33 +98,89 @@ public:
 		unsigned long tso_full;      // Number of times TSO buffer was full
 		unsigned long recs_out;      // Number of records sent to the output
 		unsigned long recs_dropped;  // Number of records dropped
+		unsigned long recs_suppressed; // Number of records suppressed by the rate limits
 		unsigned long loops;         // Number of loops the engine went through
-		unsigned long rings_indexed; // Number of times ring index was rebuilt
+		unsigned long rings_indexed; // Number of times ring index was updated
+		unsigned long rings_visited; // Number of times rings were visited by the engine
+		unsigned long rings_throttled; // Number of times rings hit their per-pass budget
+		unsigned long writers_woken; // Number of times blocked writers were woken up
 		unsigned long areas_added;   // Number of times ring index was rebuilt
 		unsigned long mask_changed;  // Number of times a mask was applied globally
 		unsigned long timesource_changed;  // Number of times the timesource was changed
+		unsigned long recorder_dumps; // Number of times flight recorders were dumped
+		unsigned long ring_pool_hits;   // Number of rings allocated from the pool
+		unsigned long ring_pool_misses; // Number of rings that could not be allocated from the pool
+		unsigned long ring_memory;   // Number of bytes allocated for the ring record buffers
+		unsigned long ring_memory_used; // Number of bytes used by the ring record buffers
+		unsigned long rings_shrunk;  // Number of rings allocated with reduced capacity
+		unsigned long rings_denied;  // Number of rings that did not fit into the memory limit
 	};
 
-	// Ring index structure
+	// Ring index structure.
+	// Entries are kept sorted by ring priority (highest first) and updated
+	// in place. New rings are queued by the adding threads and inserted
+	// by the engine thread, removed rings are invalidated and compacted out.
+	// Each entry owns a slot in the activity bitmap, only the rings with
+	// the bit set are visited (except for the periodic full pass).
 	struct ring_index {
 		struct entry {
 			ringbuf::pop_iterator pit;
 			record   *lastrec;
 			uint64_t  seqnum;
+			unsigned int slot;
+			unsigned int budget;  // Records per pass (0 - unlimited)
+			uint64_t  latency;    // Latency target in nsec (0 - none)
+		};
+
+		enum {
+			NOPOS = ~0u,
+			FULL_PASS_INTERVAL = 16 // Visit all rings every N passes
+		};
+
+		// Rings waiting to be inserted (lock-free LIFO)
+		struct pending {
+			ringbuf *ring;
+			pending *next;
 		};
 
 		entry         *entries;
 		unsigned int   count;
+		unsigned int   capacity;
+		unsigned int   dead;    // Number of invalidated entries
+		pending* volatile added;
 		volatile bool  dirty;
 
+		activity       act;
+		std::vector<unsigned int> slot_pos; // Slot to entry mapping
+		std::vector<unsigned int> active;   // Entries to visit in this pass
+		unsigned int   noslot;  // Number of entries without a slot
+		bool           full;    // Next pass must visit all entries
+		uint64_t       min_latency; // Tightest latency target in nsec (0 - none)
+
+		// Flight recorder rings. They're never drained and do not 
+		// get a slot in the activity bitmap.
+		std::vector<ringbuf *> recorders;
+
+		// Killed orphans waiting for the last reader to let go of them
+		// before they go into the pool.
+		std::vector<ringbuf *> retired;
+
 		entry* operator() (unsigned int i) { return &entries[i]; }
-		entry* operator() (ringbuf *ring);
+
+		void init();
+		void destroy();
+		void push(ringbuf *ring);
+		void insert(ringbuf *ring);
+		void remove(unsigned int i);
+		void compact();
+		void collect(bool all);
+		void rearm();
 	};
 
 private:
-	typedef std::map<std::string, area*>    area_map;
-	typedef std::map<std::string, ringbuf*> ring_map;
-	typedef pthread_mutex_t                 mutex;
+	typedef registry<area>    area_map;
+	typedef registry<ringbuf> ring_map;
+	typedef pthread_mutex_t   mutex;
 
 	/**
 	 * Magic number
@@ -118,17 +191,16 @@ private:
 	 * Container for areas
 	 */
 	area_map        _area_map;
-	mutable mutex   _area_mutex;
 
-	// Current mask
+	// Current mask (protected by mask_mutex)
 	mask            _mask;
+	mutable mutex   _mask_mutex;
 
 	/**
 	 * Container for rings
 	 */
 	ring_map        _ring_map;
 	ring_index      _ring_index;
-	mutable mutex   _ring_mutex;
 
 	/**
 	 * Timestamp ordering buffer
@@ -138,6 +210,51 @@ private:
 
 	stats           _stats;
 
+	/**
+	 * Some rings were left with records after hitting their budget
+	 */
+	bool            _backlog;
+
+	/**
+	 * Special records processed in this pass (ring and seqnum).
+	 * Acked once the output is flushed. The records themselves are
+	 * gone by then, the ring head is already committed.
+	 */
+	std::vector< std::pair<ringbuf *, uint64_t> > _acks;
+
+	/**
+	 * Allocator for the ring record buffers
+	 */
+	ringmem        *_ringmem;
+
+	/**
+	 * Pool of drained rings ready for reuse.
+	 * Filled by the engine thread, drained by add_ring().
+	 */
+	std::vector<ringbuf *> _ring_pool;
+	mutable mutex   _pool_mutex;
+
+	/**
+	 * Flight recorder dump state.
+	 * Trigger sections are matched with an overlay compiled from the trigger mask.
+	 */
+	overlay        *_trigger;
+	volatile bool   _dump_requested;
+	bool            _dump_pending;
+	const area     *_dump_area;
+	unsigned int    _dump_sect;
+	std::vector<uint8_t> _dump_buf;
+
+	/**
+	 * Last time suppressed records were reported
+	 */
+	timestamp       _suppressed_ts;
+
+	/**
+	 * Scale base of the last logged timesource calibration
+	 */
+	uint64_t        _calib_base;
+
 	pthread_t       _thread;
 	volatile bool   _running;
 	volatile bool   _killed;
@@ -167,20 +284,37 @@ private:
 	void process_rings();
 	void process_rings_notso();
 	void process_rings_tso();
+	unsigned int ring_budget(unsigned int i, const record *r);
 	void flush_record(unsigned int i, record *rec);
-	void flush_tso();
+	void flush_tso(bool all);
 	void flush_full_tso();
 	void do_flush_tso(unsigned int size);
 	void kill_orphan(unsigned int i, ringbuf *ring);
+	void recycle_rings();
+	void reclaim_overlays();
+	ringbuf *pool_get(const char *name, const ringbuf::options &opts);
+	void pool_put(ringbuf *ring);
+	ringbuf *reuse_ring(ringbuf *r);
+	void pool_flush();
+	ringbuf *alloc_ring(const char *name, const ringbuf::options &opts);
+	void update_memory_stats();
 	void drain_rings();
-	void rebuild_ring_index();
+	void update_ring_index();
 	void switch_timesource(const ringbuf *ring, record *r);
 	void add_internal_area();
+	void report_suppressed();
+	void calibrate_timesource();
+	void process_recorders();
+	void do_dump_recorders();
 
 	void inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
 				uint64_t arg0 = 0, uint64_t arg1 = 0);
 	void inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
 				const char* arg0, const char* arg1 = 0);
+	void inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
+				uint64_t arg0, const char* arg1, const char* arg2);
+	void inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
+				const char* arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3);
 
 public:
 	engine(output &out, const options &opts = default_options);
@@ -229,6 +363,9 @@ public:
 	 * Allocate new ringbuf
 	 * If ringbuf::SHARED and ringbuf::REUSABLE flags are not set the name must be unique for this engine.
 	 * Otherwise the allocation will fail, the engine will log an error, and return nullptr.
+	 * Record buffers come out of the engine's ring memory limit. If the ring does not fit
+	 * its capacity is reduced (down to MIN_RING_CAPACITY), if it still does not fit the 
+	 * allocation fails (TLS falls back to the current ring in that case).
 	 */
 	ringbuf *add_ring(const char *name, const ringbuf::options &opts);
 
@@ -237,6 +374,29 @@ public:
 	 */
 	bool add_ring(ringbuf *r);
 
+	/**
+	 * Attach flight recorder to the ring.
+	 * Allocates a recorder ring named <ring>.REC and registers it with the engine.
+	 * Sections enabled by the mask are recorded when they are disabled for the ring.
+	 * Recorded history is dumped to the output when a trigger fires.
+	 * @param ring ring to attach the recorder to
+	 * @param m mask that selects recorded sections
+	 * @param opts recorder ring options (RECORDER flag is set automatically)
+	 * @return false if the ring already has a recorder or the allocation failed
+	 */
+	bool add_recorder(ringbuf *ring, const mask &m, const ringbuf::options &opts);
+
+	/**
+	 * Dump flight recorders.
+	 * The engine dumps recorded history on the next pass.
+	 * Async signal safe, can be called from a signal handler.
+	 */
+	void dump_recorders()
+	{
+		_dump_requested = true;
+		_ring_index.act.wake();
+	}
+
 	/**
 	 * Find ring by name
 	 */
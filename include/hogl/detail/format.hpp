@@ -45,10 +45,23 @@ public:
 	/**
 	 * Data used for record formatting.
 	 * The format handler uses this to generate the final records.
+	 * Record timestamp may be raw (see timesource::raw()), the converted
+	 * one is passed separately. Records are never modified in place.
+	 * Callers must value-initialize it (format::data d = {}), zero length
+	 * and timestamp mean "not known" and formatters fall back to the ring
+	 * name and the record.
 	 */
 	struct data {
 		const char      *ring_name; /// Ring buffer name
 		const hogl::record *record; /// Pointer to the record
+		unsigned int ring_name_len; /// Ring name length (zero if not known)
+		hogl::timestamp timestamp;  /// Record timestamp in nsec (zero - use the record's)
+
+		/// Get the record timestamp in nsec
+		hogl::timestamp nsec() const
+		{
+			return timestamp == hogl::timestamp(0) ? record->timestamp : timestamp;
+		}
 	};
 
 	/**
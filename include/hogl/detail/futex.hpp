@@ -0,0 +1,78 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/futex.hpp
+ * Futex wrappers used for blocking and wakeups.
+ */
+#ifndef HOGL_DETAIL_FUTEX_HPP
+#define HOGL_DETAIL_FUTEX_HPP
+
+#include <limits.h>
+
+#include <hogl/detail/compiler.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+namespace futex {
+
+/**
+ * Wait for the value at addr to change.
+ * Returns right away if the value is already different from val.
+ * Spurious wakeups are possible, callers must recheck their condition.
+ * On the platforms without futexes this is a short sleep.
+ * @param addr futex word
+ * @param val expected value
+ * @param usec timeout in microseconds (0 means no timeout)
+ */
+void wait(volatile int *addr, int val, unsigned int usec = 0);
+
+/**
+ * Wake up threads waiting on the futex word.
+ * @param addr futex word
+ * @param n max number of threads to wake up
+ */
+void wake(volatile int *addr, int n = INT_MAX);
+
+/**
+ * CPU hint for the spin-wait loops
+ */
+static hogl_force_inline void spin_pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield" ::: "memory");
+#else
+	asm volatile("" ::: "memory");
+#endif
+}
+
+} // namespace futex
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_FUTEX_HPP
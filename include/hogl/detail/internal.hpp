@@ -53,7 +53,10 @@ enum section_ids {
 	ENGINE_DEBUG,
 	AREA_DEBUG,
 	RING_DEBUG,
-	TLS_DEBUG
+	TLS_DEBUG,
+	SUPPRESSMARK,
+	CALIBMARK,
+	DUMPMARK
 };
 
 /**
@@ -0,0 +1,93 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/limiter.h
+ * Per-ring rate limiter state.
+ */
+#ifndef HOGL_DETAIL_LIMITER_HPP
+#define HOGL_DETAIL_LIMITER_HPP
+
+#include <stdint.h>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/area.hpp>
+#include <hogl/detail/timestamp.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Rate limiter.
+ * Tracks token buckets and sampling counters for the rate limited sections
+ * that are posted into a ring. Entries are updated by the ring writer,
+ * suppressed counters are collected by the engine.
+ * The table has a fixed capacity, records from the sections that do not fit
+ * are not limited.
+ */
+class limiter {
+public:
+	enum { CAPACITY = 64 };
+
+	struct entry {
+		const hogl::area *area;  /// Area (null if the entry is free)
+		unsigned int  sect;      /// Section id
+		uint64_t      tokens;    /// Available tokens (in nsec*rate units)
+		uint64_t      last;      /// Timestamp of the last refill (nsec)
+		uint64_t      count;     /// Number of records seen (sampling)
+		uint64_t      suppressed; /// Number of suppressed records since the last report
+	};
+
+	limiter();
+
+	/**
+	 * Check if the record should be posted. Writer's interface.
+	 * @param a area pointer
+	 * @param s section id
+	 * @param now current timestamp
+	 * @return true if the record is admitted, false if it should be suppressed
+	 */
+	bool admit(const hogl::area *a, unsigned int s, hogl::timestamp now);
+
+	/**
+	 * Collect and reset suppressed counter. Reader's interface.
+	 * @param i entry index
+	 * @param a reference to the area pointer (set on return)
+	 * @param s reference to the section id (set on return)
+	 * @return number of records suppressed since the last call
+	 */
+	uint64_t take_suppressed(unsigned int i, const hogl::area *&a, unsigned int &s);
+
+private:
+	entry _entry[CAPACITY];
+
+	entry *find(const hogl::area *a, unsigned int s, hogl::timestamp now, const area::limit &l);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_LIMITER_HPP
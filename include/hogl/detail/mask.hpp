@@ -35,8 +35,10 @@
 #include <iostream>
 #include <string>
 #include <list>
+#include <vector>
 
 #include <hogl/detail/area.hpp>
+#include <hogl/detail/bitmap.hpp>
 
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
@@ -45,10 +47,16 @@ namespace hogl {
  * Logging mask.
  */
 class mask {
+public:
+	struct cache;
+
 private:
 	struct data;
 	typedef std::list<data> data_list;
 	data_list  *_list;
+	cache      *_cache;
+
+	bool match(const area &a, std::vector<const data *> &rules) const;
 
 public:
 	/**
@@ -72,7 +80,9 @@ public:
 
 	/**
  	 * Add string.
- 	 * @param str area name + section name or POSIX regex.
+ 	 * @param str area name + section name or POSIX regex, optionally followed
+ 	 * by the rate limit spec. For example "NET:DEBUG@1000/s" (at most 1000 records per second),
+ 	 * "NET:DEBUG@1/100" (post one in 100 records) or "NET:DEBUG@1/10,1000/s".
  	 */
 	void add(const std::string &str);
 
@@ -84,6 +94,14 @@ public:
 	void apply(area &a) const;
 	void apply(area *a) const { apply(*a); };
 
+	/**
+ 	 * Get the sections of the area enabled by this mask.
+ 	 * The area itself is not changed.
+ 	 * @param a area reference
+ 	 * @param b bitmap that receives one bit per section
+ 	 */
+	void apply(const area &a, bitmap &b) const;
+
 	/**
  	 * Add string.
  	 * @param str area name + section name or POSIX regex.
@@ -0,0 +1,105 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/overlay.hpp
+ * Per-ring mask overlay.
+ */
+#ifndef HOGL_DETAIL_OVERLAY_HPP
+#define HOGL_DETAIL_OVERLAY_HPP
+
+#include <pthread.h>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/barrier.hpp>
+#include <hogl/detail/area.hpp>
+#include <hogl/detail/bitmap.hpp>
+#include <hogl/detail/mask.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Mask overlay.
+ * Enables extra sections for the records posted into one ring, on top
+ * of the global area bitmaps. Sections enabled by the overlay are posted
+ * even if they are disabled globally, the overlay never disables anything.
+ * Per-area section bitmaps are compiled on first use by the writers.
+ * The table has a fixed capacity, areas that do not fit are not overlaid.
+ * Once the table is full the lookups never take the lock.
+ */
+class overlay {
+public:
+	enum { CAPACITY = 64 };
+
+	explicit overlay(const mask &m);
+	~overlay();
+
+	/**
+	 * Test if the section is enabled by the overlay. Writer's interface.
+	 * @param a area pointer
+	 * @param s section id
+	 */
+	bool test(const hogl::area *a, unsigned int s)
+	{
+		unsigned int n = _count;
+		barrier::memr();
+		for (unsigned int i = 0; i < n; i++) {
+			if (_entry[i].area == a)
+				return _entry[i].sect.test(s);
+		}
+		if (n == CAPACITY)
+			return false;
+		return compile(a, s);
+	}
+
+	/**
+	 * Next overlay in the list of retired overlays
+	 */
+	overlay *next;
+
+private:
+	struct entry {
+		const hogl::area *area;
+		bitmap            sect;
+	};
+
+	mask                  _mask;
+	entry                 _entry[CAPACITY];
+	volatile unsigned int _count;
+	pthread_mutex_t       _mutex;
+
+	bool compile(const hogl::area *a, unsigned int s);
+
+	// No copies
+	overlay(const overlay&);
+	overlay& operator=(const overlay&);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_OVERLAY_HPP
@@ -33,9 +33,12 @@
 
 #include <stdint.h>
 
+#include <type_traits>
+
 #include <hogl/detail/compiler.hpp>
 #include <hogl/detail/preproc.hpp>
 #include <hogl/detail/area.hpp>
+#include <hogl/detail/argpack.hpp>
 #include <hogl/detail/record.hpp>
 #include <hogl/detail/ringbuf.hpp>
 
@@ -49,8 +52,92 @@ record* begin_locked(ringbuf *ring, const area *a, unsigned int s);
 void finish_unlocked(ringbuf *ring);
 void finish_locked(ringbuf *ring);
 
-void unlocked(ringbuf *ring, const area *a, unsigned int s, const argpack &ap);
-void locked(ringbuf *ring, const area *a, unsigned int s, const argpack &ap);
+void unlocked(ringbuf *ring, const area *a, unsigned int s, uint64_t argtype, const argpack_item *item);
+void locked(ringbuf *ring, const area *a, unsigned int s, uint64_t argtype, const argpack_item *item);
+
+void discard(uint64_t argtype, const argpack_item *item);
+
+bool admit(ringbuf *ring, const area *a, unsigned int s);
+bool admit_unlocked(ringbuf *ring, const area *a, unsigned int s);
+bool overlaid(ringbuf *ring, const area *a, unsigned int s);
+bool recorded(ringbuf *ring, const area *a, unsigned int s);
+
+/**
+ * Check if all arguments are simple (resolved at compile time)
+ */
+template<typename... A> struct simple_args;
+
+template<> struct simple_args<> : std::true_type { };
+
+template<typename A, typename... R> struct simple_args<A, R...> :
+	std::integral_constant<bool, arg_traits<typename std::decay<A>::type>::simple && simple_args<R...>::value> { };
+
+/**
+ * Check if any of the arguments may hold borrowed data (resolved at compile time)
+ */
+template<typename... A> struct borrowed_args;
+
+template<> struct borrowed_args<> : std::false_type { };
+
+template<typename A, typename... R> struct borrowed_args<A, R...> :
+	std::integral_constant<bool, arg_traits<typename std::decay<A>::type>::borrowed || borrowed_args<R...>::value> { };
+
+/**
+ * Discard a record that is not posted.
+ * Borrowed data is released out of line. Nothing is generated for the
+ * records without borrowed data.
+ */
+template<typename... A>
+hogl_force_inline void discard(std::false_type, const A&...) { }
+
+template<typename... A>
+hogl_force_inline void discard(std::true_type, const A&... args)
+{
+	argpack<sizeof...(A)> ap;
+	uint64_t type = ap.populate(args...);
+	discard(type, ap.item);
+}
+
+/**
+ * Push a record with simple arguments.
+ * Arguments are stored directly into the record inline.
+ */
+template<typename... A>
+hogl_force_inline void push_unlocked(std::true_type, ringbuf *ring, const area *a, unsigned int s, const A&... args)
+{
+	record *r = begin_unlocked(ring, a, s);
+	r->set_args(ring->record_tailroom(), args...);
+	finish_unlocked(ring);
+}
+
+template<typename... A>
+hogl_force_inline void push_locked(std::true_type, ringbuf *ring, const area *a, unsigned int s, const A&... args)
+{
+	record *r = begin_locked(ring, a, s);
+	r->set_args(ring->record_tailroom(), args...);
+	finish_locked(ring);
+}
+
+/**
+ * Push a record with complex arguments (cstr, hexdump, etc).
+ * All processing is done out of line. Only the arguments that are
+ * actually used are passed.
+ */
+template<typename... A>
+hogl_force_inline void push_unlocked(std::false_type, ringbuf *ring, const area *a, unsigned int s, const A&... args)
+{
+	argpack<sizeof...(A)> ap;
+	uint64_t type = ap.populate(args...);
+	unlocked(ring, a, s, type, ap.item);
+}
+
+template<typename... A>
+hogl_force_inline void push_locked(std::false_type, ringbuf *ring, const area *a, unsigned int s, const A&... args)
+{
+	argpack<sizeof...(A)> ap;
+	uint64_t type = ap.populate(args...);
+	locked(ring, a, s, type, ap.item);
+}
 
 } // namespace post_impl
 
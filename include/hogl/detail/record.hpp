@@ -38,6 +38,8 @@
 #include <hogl/detail/area.hpp>
 #include <hogl/detail/args.hpp>
 #include <hogl/detail/argpack.hpp>
+#include <hogl/detail/strcopy.hpp>
+#include <hogl/detail/arena.hpp>
 #include <hogl/detail/preproc.hpp>
 
 __HOGL_PRIV_NS_OPEN__
@@ -51,6 +53,15 @@ class area;
 struct record {
 	enum { NARGS = 16 };
 
+	// Argument data that lives outside of the record, in the payload arena
+	// (see spill()) or in the borrowed buffer (see borrow()).
+	// The record keeps a pointer to the data instead of the data itself.
+	// Borrowed data pointer is followed by the rest of arg_borrow.
+	enum { 
+		EXTERN_DATA   = 0x80000000,
+		BORROWED_DATA = 0x40000000
+	};
+
 	const hogl::area *area;
 	hogl::timestamp   timestamp;
 	uint64_t seqnum  :52;
@@ -170,7 +181,12 @@ struct record {
 	const uint8_t *get_arg_data(unsigned int i, unsigned int &len) const
 	{
 		len = argval[i].data.len;
-		return (const uint8_t*) this->argval + argval[i].data.offset;
+		const uint8_t *data = (const uint8_t*) this->argval + argval[i].data.offset;
+		if (hogl_unlikely(len & EXTERN_DATA)) {
+			len &= ~(EXTERN_DATA | BORROWED_DATA);
+			memcpy(&data, data, sizeof(data));
+		}
+		return data;
 	}
 
 	/**
@@ -195,6 +211,22 @@ struct record {
 		--room; // Save room for null-terminator
 
 		uint8_t *dst = (uint8_t *) this->argval + offset;
+		if (len == arg::UNKNOWN_LEN) {
+			// Scan and copy in one pass, bounded by the room
+			len = strcopy(dst, str, room);
+			if (!len) {
+				set_arg_data(i, 0, 0);
+				return 0;
+			}
+			// Doesn't fit. Add truncation marker (if possible)
+			if (len == room && str[room] && len > 3)
+				memcpy(dst + len - 3, ">>>", 3);
+			dst[len] = '\0';
+
+			set_arg_data(i, offset, len);
+			return len + 1;
+		}
+
 		unsigned int n = len; // Copy len
 		if (n > room) {
 			// Doesn't fit. Add truncation marker (if possible)
@@ -260,6 +292,144 @@ struct record {
 		return len;
 	}
 
+	/**
+	 * Allocate argument data in the payload arena.
+	 * The pointer to the data is stored in the record buffer.
+	 * @param i argument index
+	 * @param ar payload arena
+	 * @param size number of bytes to allocate
+	 * @param len length of the argument data
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return pointer to the data buffer or null if the arena is full
+	 */
+	uint8_t *spill(unsigned int i, hogl::arena *ar, unsigned int size, unsigned int len, unsigned int tailroom, unsigned int &offset)
+	{
+		if (tailroom - offset < sizeof(uint8_t *))
+			return 0;
+
+		uint8_t *dst = ar->alloc(seqnum, size);
+		if (!dst)
+			return 0;
+
+		memcpy((uint8_t *) this->argval + offset, &dst, sizeof(dst));
+		set_arg_data(i, offset, len | EXTERN_DATA);
+		offset += sizeof(dst);
+		return dst;
+	}
+
+	/**
+	 * Copy cstr into the payload arena.
+	 * @param i argument index
+	 * @param ar payload arena
+	 * @param str pointer to the source string
+	 * @param n number of bytes already scanned (known to be non-zero)
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return true on success, false if the arena is full
+	 */
+	bool spill_cstr(unsigned int i, hogl::arena *ar, const uint8_t *str, unsigned int n, unsigned int tailroom, unsigned int &offset)
+	{
+		unsigned int len = n + strlen((const char *) str + n);
+		uint8_t *dst = spill(i, ar, len + 1, len, tailroom, offset);
+		if (!dst)
+			return false;
+		memcpy(dst, str, len + 1);
+		return true;
+	}
+
+	/**
+	 * Copy data into the payload arena.
+	 * @param i argument index
+	 * @param ar payload arena
+	 * @param data pointer to the data buffer
+	 * @param len length of the data
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return true on success, false if the arena is full
+	 */
+	bool spill_data(unsigned int i, hogl::arena *ar, const uint8_t *data, unsigned int len, unsigned int tailroom, unsigned int &offset)
+	{
+		uint8_t *dst = spill(i, ar, len, len, tailroom, offset);
+		if (!dst)
+			return false;
+		memcpy(dst, data, len);
+		return true;
+	}
+
+	/**
+	 * Copy xdump into the payload arena.
+	 * @param i argument index
+	 * @param ar payload arena
+	 * @param xd pointer to the xdump argument
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return true on success, false if the arena is full
+	 */
+	bool spill_xdump(unsigned int i, hogl::arena *ar, const arg_xdump* xd, unsigned int tailroom, unsigned int &offset)
+	{
+		const unsigned int hlen = sizeof(xd->fmt);
+		uint8_t *dst = spill(i, ar, hlen + xd->len, hlen + xd->len, tailroom, offset);
+		if (!dst)
+			return false;
+		memcpy(dst + 0x00, (const void *) &xd->fmt, hlen);
+		memcpy(dst + hlen, (const void *) xd->ptr, xd->len);
+		return true;
+	}
+
+	/**
+	 * Store a reference to the borrowed data.
+	 * The reference (see arg_borrow) is stored in the record buffer.
+	 * @param i argument index
+	 * @param b borrowed data
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return true on success, false if the reference does not fit
+	 */
+	bool borrow(unsigned int i, const arg_borrow *b, unsigned int tailroom, unsigned int &offset)
+	{
+		if (tailroom - offset < sizeof(*b))
+			return false;
+
+		memcpy((uint8_t *) this->argval + offset, b, sizeof(*b));
+		set_arg_data(i, offset, b->len | EXTERN_DATA | BORROWED_DATA);
+		offset += sizeof(*b);
+		return true;
+	}
+
+	/**
+	 * Copy borrowed data into the record and release it.
+	 * @param i argument index
+	 * @param b borrowed data
+	 * @param tailroom amount of tailroom left in the record buffer
+	 * @param offset offset in the record buffer
+	 * @return number of bytes used in the record buffer
+	 */
+	unsigned int copy_borrowed(unsigned int i, const arg_borrow *b, unsigned int tailroom, unsigned int offset)
+	{
+		unsigned int n = copy_data(i, (const uint8_t *) b->ptr, b->len, tailroom, offset);
+		b->release(b->ptr, b->ctx);
+		return n;
+	}
+
+	/**
+	 * Release borrowed data.
+	 * Calls release callbacks of all borrowed arguments.
+	 */
+	void release_borrowed()
+	{
+		unsigned int i = 0;
+		for (uint64_t t = argtype; t; t >>= 4, i++) {
+			if ((t & 0xf) != arg::RAW || !(argval[i].data.len & BORROWED_DATA))
+				continue;
+
+			arg_borrow b(0, 0, 0);
+			memcpy(&b, (const uint8_t *) this->argval + argval[i].data.offset, sizeof(b));
+			argval[i].data.len &= ~BORROWED_DATA;
+			b.release(b.ptr, b.ctx);
+		}
+	}
+
 	/**
  	 * Set record argument
  	 * @param i index (position) of the argument (zero based)
@@ -276,7 +446,14 @@ struct record {
 		if (a.type == a.NONE)
 			return;
 
-		set_arg_type(i, a.type);
+		// Borrowed data is stored as RAW. This version does not keep
+		// the references, the data is copied and released right away.
+		set_arg_type(i, a.type == a.BORROW ? (unsigned int) a.RAW : a.type);
+
+		if (a.type == a.BORROW) {
+			offset += copy_borrowed(i, (const arg_borrow *) a.val, tailroom, offset);
+			return;
+		}
 
 		if (a.type == a.RAW) {
 			offset += copy_data(i, (const uint8_t *) a.val, a.len, tailroom, offset);
@@ -299,54 +476,94 @@ struct record {
 			set_arg_val64(i, a.val);
 	}
 
+	// Set arguments starting at index I (compile-time recursion over the argument list)
+	template<unsigned int I>
+	hogl_force_inline void set_args_at(unsigned int, unsigned int &) { }
+
+	template<unsigned int I, typename A, typename... R>
+	hogl_force_inline void set_args_at(unsigned int tailroom, unsigned int &offset, const A &a, const R&... r)
+	{
+		set_arg(I, hogl::arg(a), tailroom, offset);
+		set_args_at<I + 1>(tailroom, offset, r...);
+	}
+
 	/**
- 	 * Populate record arguments
+ 	 * Populate record arguments.
+ 	 * Exact arity version. One set_arg() is generated for each argument and 
+ 	 * all type checks are resolved at compile time.
  	 * @param tailroom number of bytes available at the tail of the record (used as generic buffer).
- 	 * @param arg0 ... arg1 argument list
+ 	 * @param a argument list (anything hogl::arg can be constructed from)
  	 */
-	hogl_force_inline void set_args(unsigned int tailroom, __hogl_long_arg_list(16))
+	template<typename... A>
+	hogl_force_inline void set_args(unsigned int tailroom, const A&... a)
 	{
-		// Compute the number of valid arguments (resolved at compile time)
-		unsigned int n = 0;
-		#define __hogl_record_valid_arg(i) n += (a##i.type != arg::NONE)
-		HOGL_PP_REPS(16, __hogl_record_valid_arg, ;);
+		static_assert(sizeof...(A) <= NARGS, "hogl: too many arguments");
 
-		// Compute offset based on the number of valid arguments
-		unsigned int offset = n * sizeof(uint64_t);
+		// Complex args are packed after the argument values
+		unsigned int offset = sizeof...(A) * sizeof(uint64_t);
 
-		// Populate arguments
 		argtype = 0;
-		#define __hogl_record_set_arg(i) set_arg(i, a##i, tailroom, offset)
-		HOGL_PP_REPS(16, __hogl_record_set_arg, ;);
+		set_args_at<0>(tailroom, offset, a...);
 	}
 
 	/**
- 	 * Populate record arguments
+ 	 * Populate record arguments from the packed arguments.
+ 	 * Used by the out of line post path.
+	 * Arguments that do not fit into the tailroom go into the payload arena (if any).
  	 * @param tailroom number of bytes available at the tail of the record (used as generic buffer).
- 	 * @param ap reference to the pre-processed and packed arguments
+ 	 * @param type packed argument types (see argtype)
+ 	 * @param item pointer to the packed argument values
+	 * @param ar payload arena (null - truncate large arguments)
+	 * @param keep keep references to the borrowed data (false - copy and release)
+	 * @return true if the record holds references to the borrowed data (see release_borrowed())
  	 */
-	hogl_force_inline void set_args(unsigned int tailroom, const argpack &ap)
+	hogl_force_inline bool set_packed_args(unsigned int tailroom, uint64_t type, const argpack_item *item, hogl::arena *ar = 0, bool keep = false)
 	{
-		unsigned int n = ap.nargs();
+		bool borrowed = false;
+		unsigned int n = 0;
+		for (uint64_t t = type; t; t >>= 4) ++n;
 		unsigned int offset = n * sizeof(uint64_t);
 
-		argtype = ap.argtype;
+		argtype = type;
 		for (unsigned int i=0; i < n; i++) {
-			unsigned int type = ap.get_arg_type(i);
+			unsigned int t = get_arg_type(i);
 			const uint8_t *data; unsigned int len;
 
-			if (type == arg::RAW) {
-				data = ap.get_arg_data(i, len);
+			if (t == arg::BORROW) {
+				const arg_borrow *b = (const arg_borrow *) item[i].data(len);
+				clear_arg_type(i);
+				set_arg_type(i, arg::RAW);
+				if (keep && borrow(i, b, tailroom, offset)) {
+					borrowed = true;
+					continue;
+				}
+				offset += copy_borrowed(i, b, tailroom, offset);
+			} else if (t == arg::RAW) {
+				data = item[i].data(len);
+				if (hogl_unlikely(ar && len > tailroom - offset) &&
+						spill_data(i, ar, data, len, tailroom, offset))
+					continue;
 				offset += copy_data(i, data, len, tailroom, offset);
-			} else if (type == arg::XDUMP) {
-				data = ap.get_arg_data(i, len);
-				offset += copy_xdump(i, (const arg_xdump *) data, tailroom, offset);
-			} else if (type == arg::CSTR) {
-				data = ap.get_arg_data(i, len);
-				offset += copy_cstr(i, data, len, tailroom, offset);
+			} else if (t == arg::XDUMP) {
+				data = item[i].data(len);
+				const arg_xdump *xd = (const arg_xdump *) data;
+				if (hogl_unlikely(ar && sizeof(xd->fmt) + xd->len > tailroom - offset) &&
+						spill_xdump(i, ar, xd, tailroom, offset))
+					continue;
+				offset += copy_xdump(i, xd, tailroom, offset);
+			} else if (t == arg::CSTR) {
+				data = item[i].data(len);
+				unsigned int n = copy_cstr(i, data, len, tailroom, offset);
+				// Truncated strings go into the arena.
+				// Copy stops either at the null terminator or at the end of the room.
+				if (hogl_unlikely(ar) && data && data[argval[i].data.len] &&
+						spill_cstr(i, ar, data, argval[i].data.len, tailroom, offset))
+					continue;
+				offset += n;
 			} else
-				set_arg_val64(i, ap.get_arg_val64(i));
+				set_arg_val64(i, item[i].val.u64);
 		}
+		return borrowed;
 	}
 
 	/**
@@ -0,0 +1,323 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/registry.h
+ * Read-mostly name registry.
+ */
+#ifndef HOGL_DETAIL_REGISTRY_HPP
+#define HOGL_DETAIL_REGISTRY_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <vector>
+
+#include <hogl/detail/compiler.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Read-mostly registry of named objects.
+ * Objects are looked up by name (T::name()) in an immutable hashed snapshot.
+ * Updates are serialized by a mutex, they build a new snapshot and publish it
+ * atomically. Readers never lock and never wait.
+ * Old snapshots (and values removed from the registry) are reclaimed RCU-style
+ * once all readers that could have seen them are gone. Readers are tracked with
+ * a pair of counters indexed by the epoch parity.
+ */
+template <typename T>
+class registry {
+public:
+	/**
+	 * Immutable snapshot of the registry
+	 */
+	struct snapshot {
+		unsigned int  mask;  /// Hash table size - 1
+		unsigned int  count; /// Number of items
+		T           **table; /// Hash table (open addressing)
+		T           **items; /// All items in insertion order
+
+		T *find(const char *name, uint32_t h) const
+		{
+			for (unsigned int i = h; ; i++) {
+				T *v = table[i & mask];
+				if (!v)
+					return 0;
+				if (!strcmp(v->name(), name))
+					return v;
+			}
+		}
+	};
+
+	typedef void (*dispose_fn)(T *v);
+
+	/**
+	 * Read-side critical section.
+	 * Snapshot and all the items in it stay valid while the reader is alive.
+	 */
+	class reader {
+	private:
+		const registry &_reg;
+		unsigned int    _idx;
+		const snapshot *_snap;
+
+	public:
+		explicit reader(const registry &r) : _reg(r)
+		{
+			_idx  = _reg.read_lock();
+			_snap = _reg._snap;
+		}
+
+		~reader() { _reg.read_unlock(_idx); }
+
+		const snapshot& operator*()  const { return *_snap; }
+		const snapshot* operator->() const { return _snap; }
+
+		T *find(const char *name) const { return _snap->find(name, registry::hash(name)); }
+	};
+
+	static uint32_t hash(const char *s)
+	{
+		uint32_t h = 2166136261U;
+		for (; *s; s++)
+			h = (h ^ (uint8_t) *s) * 16777619U;
+		return h;
+	}
+
+	/**
+	 * Create registry.
+	 * @param dispose function that is called for the values removed from the registry
+	 * once no readers can see them anymore (null means do nothing).
+	 */
+	explicit registry(dispose_fn dispose = 0) :
+		_dispose(dispose), _epoch(0)
+	{
+		pthread_mutex_init(&_mutex, NULL);
+		_readers[0] = _readers[1] = 0;
+		_snap = build(0, 0, 0);
+	}
+
+	~registry()
+	{
+		reclaim(_retired_old);
+		reclaim(_retired);
+		free_snapshot((snapshot *) _snap);
+		pthread_mutex_destroy(&_mutex);
+	}
+
+	/**
+	 * Find value by name. Wait-free.
+	 * Only safe for values that are never removed from the registry,
+	 * use reader otherwise.
+	 */
+	T *find(const char *name) const
+	{
+		reader r(*this);
+		return r.find(name);
+	}
+
+	/**
+	 * Insert new value.
+	 * @param v value to insert
+	 * @param exists function that is called (under the update lock) with the
+	 *  existing value if the value with the same name is already registered.
+	 * @return true if the value was inserted, false if the name already exists.
+	 */
+	template <typename F>
+	bool insert(T *v, F exists)
+	{
+		pthread_mutex_lock(&_mutex);
+
+		const snapshot *s = _snap;
+		T *e = s->find(v->name(), hash(v->name()));
+		if (e) {
+			exists(e);
+			pthread_mutex_unlock(&_mutex);
+			return false;
+		}
+
+		update(build(s, v, 0));
+		pthread_mutex_unlock(&_mutex);
+		return true;
+	}
+
+	bool insert(T *v) { return insert(v, [](T *) {}); }
+
+	/**
+	 * Remove value.
+	 * The value is disposed once no readers can see it.
+	 * @param v value to remove
+	 * @param wait if false, give up instead of waiting for a concurrent update.
+	 * @return true if the value was removed
+	 */
+	bool erase(T *v, bool wait = true)
+	{
+		if (wait)
+			pthread_mutex_lock(&_mutex);
+		else if (pthread_mutex_trylock(&_mutex))
+			return false;
+
+		const snapshot *s = _snap;
+		bool found = (s->find(v->name(), hash(v->name())) == v);
+		if (found) {
+			retired r = { 0, v };
+			_retired.push_back(r);
+			update(build(s, 0, v));
+		}
+
+		pthread_mutex_unlock(&_mutex);
+		return found;
+	}
+
+	/**
+	 * Reclaim retired snapshots and values if possible.
+	 * Normally this happens on updates. Does nothing if an update is in progress.
+	 */
+	void sync()
+	{
+		if (pthread_mutex_trylock(&_mutex))
+			return;
+		if (!_retired.empty() || !_retired_old.empty())
+			try_reclaim();
+		pthread_mutex_unlock(&_mutex);
+	}
+
+private:
+	struct retired {
+		snapshot *snap;
+		T        *val;
+	};
+	typedef std::vector<retired> retired_list;
+
+	dispose_fn              _dispose;
+	pthread_mutex_t         _mutex;
+	const snapshot* volatile _snap;
+	volatile unsigned int   _epoch;
+	mutable volatile unsigned long _readers[2];
+	retired_list            _retired;     // retired in the current epoch
+	retired_list            _retired_old; // retired in the previous epoch
+
+	unsigned int read_lock() const
+	{
+		unsigned int i = _epoch & 1;
+		__sync_fetch_and_add(&_readers[i], 1);
+		return i;
+	}
+
+	void read_unlock(unsigned int i) const
+	{
+		__sync_fetch_and_sub(&_readers[i], 1);
+	}
+
+	// Build new snapshot from the old one, adding and/or removing a value
+	static snapshot *build(const snapshot *o, T *add, T *del)
+	{
+		unsigned int n = (o ? o->count : 0) + (add ? 1 : 0);
+
+		unsigned int size = 16;
+		while (size < n * 2)
+			size <<= 1;
+
+		snapshot *s = new snapshot;
+		s->mask  = size - 1;
+		s->count = 0;
+		s->table = new T* [size];
+		s->items = new T* [n ? n : 1];
+		memset(s->table, 0, sizeof(T*) * size);
+
+		if (o) {
+			for (unsigned int i = 0; i < o->count; i++)
+				if (o->items[i] != del)
+					s->items[s->count++] = o->items[i];
+		}
+		if (add)
+			s->items[s->count++] = add;
+
+		for (unsigned int i = 0; i < s->count; i++) {
+			T *v = s->items[i];
+			unsigned int h = hash(v->name());
+			while (s->table[h & s->mask])
+				h++;
+			s->table[h & s->mask] = v;
+		}
+
+		return s;
+	}
+
+	static void free_snapshot(snapshot *s)
+	{
+		delete [] s->table;
+		delete [] s->items;
+		delete s;
+	}
+
+	void reclaim(retired_list &l)
+	{
+		for (unsigned int i = 0; i < l.size(); i++) {
+			if (l[i].snap)
+				free_snapshot(l[i].snap);
+			if (l[i].val && _dispose)
+				_dispose(l[i].val);
+		}
+		l.clear();
+	}
+
+	// Reclaim things retired in the previous epoch if all readers from
+	// that epoch are gone, and start the new epoch.
+	// Called under the update lock.
+	void try_reclaim()
+	{
+		if (_readers[(_epoch - 1) & 1])
+			return;
+
+		reclaim(_retired_old);
+		_retired_old.swap(_retired);
+		__sync_fetch_and_add(&_epoch, 1);
+	}
+
+	// Publish new snapshot. Called under the update lock.
+	void update(snapshot *s)
+	{
+		retired r = { (snapshot *) _snap, 0 };
+		__sync_synchronize();
+		_snap = s;
+		__sync_synchronize();
+		_retired.push_back(r);
+		try_reclaim();
+	}
+
+	// No copies
+	registry(const registry&);
+	registry& operator=(const registry&);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_REGISTRY_HPP
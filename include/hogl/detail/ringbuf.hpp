@@ -42,6 +42,7 @@
 #include <hogl/detail/compiler.hpp>
 #include <hogl/detail/barrier.hpp>
 #include <hogl/detail/refcount.hpp>
+#include <hogl/detail/activity.hpp>
 #include <hogl/detail/record.hpp>
 #include <hogl/detail/magic.hpp>
 #include <hogl/detail/args.hpp>
@@ -53,6 +54,11 @@ namespace hogl {
 
 class engine;
 class recovery_engine;
+class limiter;
+class overlay;
+class mask;
+class ringmem;
+class arena;
 
 /**
  * Ring buffer. Simple and efficient circular fifo.
@@ -73,14 +79,24 @@ protected:
 	// Magic number
 	magic           _magic;
 	char           *_name;
+	unsigned int    _name_len;
 	unsigned int    _flags;
 	int             _prio;
+	unsigned int    _budget;
+	unsigned int    _max_latency;
+	unsigned int    _reserve;
 
 	// Record buffers (top addr, index shift, tailroom)
 	uint8_t        *_rec_top;
 	unsigned int    _rec_shift;
 	unsigned int    _rec_tailroom;
 
+	// Allocator the record buffers came from (null - system)
+	hogl::ringmem  *_mem;
+
+	// Payload arena for the large arguments (null - none)
+	hogl::arena    *_arena;
+
 	// Ring capacity
 	// After initialization this is set to the total number of records - 1
 	unsigned int    _capacity;
@@ -91,23 +107,48 @@ protected:
 	// Protects push in shared rings
    	pthread_mutex_t _mutex;
 
-	// Mutex and condition for blocked writers
-	pthread_mutex_t _block_mutex;
-	pthread_cond_t  _block_cond;
-	volatile bool   _block_active; /// At least one blocked writer
+	// Blocked writer state.
+	// Writer spins for a while and then parks on the futex word.
+	volatile int    _block_seq;     /// Futex word, bumped by the reader on wakeup
+	volatile int    _block_waiters; /// Writer is (about to get) parked
+	unsigned int    _block_spin;    /// Adaptive spin count
 
-	// Timesource
+	// Timesource and its built-in clock id (read inline by the writers)
 	hogl::timesource* volatile _timesource;
+	volatile unsigned int _ts_clock;
+
+	// Rate limiter state (allocated on first use by the writer)
+	hogl::limiter* volatile _limiter;
+
+	// Mask overlay and the overlays it replaced. Writers that use the overlay
+	// are counted per epoch (same scheme as the registry), retired overlays
+	// are freed by the engine once no writer can see them.
+	hogl::overlay* volatile _overlay;
+	hogl::overlay*  _overlay_retired;     // retired in the current epoch
+	hogl::overlay*  _overlay_retired_old; // retired in the previous epoch
+	volatile unsigned int _overlay_epoch;
+	mutable volatile unsigned long _overlay_readers[2];
+
+	void try_reclaim_overlays();
+
+	// Flight recorder attached to this ring (if any)
+	ringbuf* volatile _recorder;
+
+	// Engine activity bitmap and our slot in it (set by the engine)
+	hogl::activity* volatile _activity;
+	unsigned int    _activity_slot;
 
 	// R/W access by the writer
 	// R/O access by the reader
 	vo_uint         _tail; // __attribute__ ((aligned(64)));
 	uint64_t        _seqnum;
 	uint64_t        _dropcnt;
+	volatile bool   _borrows; // Records may hold borrowed data
 
 	// R/W access by the reader
 	// R/O access by the writer
 	vo_uint         _head;
+	volatile uint64_t _ack_seqnum; // Last acked special record seqnum + 1
 
 	/**
  	 * Get a pointer the record with a specific index 
@@ -141,6 +182,11 @@ protected:
 		if (bar)
 			barrier::memr();
 
+		// Release arena space used by the records we're done with.
+		// Head points to the last record consumed by the reader.
+		if (_arena && head != _head)
+			release_arena(get_record(head)->seqnum);
+
 		_head = head;
 	}
 
@@ -157,8 +203,32 @@ protected:
 			barrier::memw();
 
 		_tail = tail;
+
+		activity *a = _activity;
+		if (a)
+			a->mark(_activity_slot);
 	}
 
+	/**
+	 * Check if committing the record at the tail would eat into
+	 * the reserved room. Critical and special records are allowed in.
+	 * Writer's interface.
+	 */
+	bool reserved(unsigned int tail)
+	{
+		if (hogl_likely(!_reserve) || room() > _reserve)
+			return false;
+		record *r = get_record(tail);
+		if (!r->area)
+			return !r->special();
+		return !r->area->critical(r->section);
+	}
+
+	void set_reserve(unsigned int n);
+	void set_arena(unsigned int size);
+	void release_arena(uint64_t seqnum);
+	void release_borrowed();
+
 public:
 	/**
 	 * Ring flags.
@@ -174,6 +244,11 @@ public:
 	 * thread wants to create TLS ring with the name that it used before, 
 	 * which means that the original ring may still be registered with 
 	 * the engine.
+	 *
+	 * Recorder rings keep the history of the most recent records. Writers
+	 * overwrite the oldest records instead of dropping new ones and the 
+	 * engine does not drain these rings. The history is dumped through 
+	 * the normal output path when a trigger fires.
 	 */
 	enum flags {
 		/** Shared ring */
@@ -186,7 +261,10 @@ public:
 		REUSABLE   = (1<<2),
 
 		/** Writers will block if the ring is full */
-		BLOCKING   = (1<<3)
+		BLOCKING   = (1<<3),
+
+		/** Flight recorder, overwrites the oldest records */
+		RECORDER   = (1<<4)
 	};
 
 	enum {
@@ -209,14 +287,22 @@ public:
 		unsigned int prio;            // Ring priority
 		unsigned int flags;           // Flags (see above)
 		unsigned int record_tailroom; // Tailroom (includes argument storage, see record::argval_size)
+		unsigned int budget;          // Max number of records the engine processes per pass (0 - unlimited)
+		unsigned int max_latency_usec; // Latency target, budget is ignored for late records (0 - none)
+		unsigned int reserve;         // Number of records reserved for the critical sections (0 - none)
+		unsigned int arena_size;      // Size of the payload arena for the large arguments in bytes (0 - none)
 	};
 
 	static options default_options;
 
 	/**
 	 * Allocate the ring
+	 * @param name ring name
+	 * @param opts ring options
+	 * @param mem allocator for the record buffers (null - system). 
+	 *    Check allocated() for the allocation failures.
 	 */
-	ringbuf(const char *name, const options &opts = default_options);
+	ringbuf(const char *name, const options &opts = default_options, hogl::ringmem *mem = 0);
 
 	/**
 	 * Destroy the ring
@@ -232,12 +318,37 @@ public:
 	 */
 	void reset(void);
 
+	/**
+	 * Check if the ring has the geometry (capacity and record size)
+	 * requested by the options. Used for recycling the rings.
+	 */
+	bool fits(const options &opts) const;
+
+	/**
+	 * Reinitialize the ring for reuse.
+	 * Keeps the record buffers (already allocated and faulted in) and resets
+	 * everything else as if the ring was allocated with these options.
+	 * The ring must not be in use and must fit the options.
+	 */
+	void recycle(const char *name, const options &opts);
+
 	/**
 	 * Get ring name
 	 * @return ring name
 	 */
 	const char *name() const { return _name; }
 
+	/**
+	 * Get ring name length
+	 * @return ring name length
+	 */
+	unsigned int name_len() const { return _name_len; }
+
+	/**
+	 * Check if the record buffers were allocated
+	 */
+	bool allocated() const { return _rec_top != 0; }
+
 	/**
 	 * Get record size
 	 * @return size of the record in bytes
@@ -281,6 +392,27 @@ public:
 	 */
 	int prio() const { return _prio; }
 
+	/**
+	 * Get per-pass record budget of this ring (0 - unlimited)
+	 */
+	unsigned int budget() const { return _budget; }
+
+	/**
+	 * Get latency target of this ring in usec (0 - none)
+	 */
+	unsigned int max_latency_usec() const { return _max_latency; }
+
+	/**
+	 * Get number of records reserved for the critical sections
+	 */
+	unsigned int reserve() const { return _reserve; }
+
+	/**
+	 * Get payload arena of this ring
+	 * @return pointer to the arena or null if the ring does not have one
+	 */
+	hogl::arena* arena() const { return _arena; }
+
 	/**
          * Get number of dropped messages 
 	 */
@@ -316,6 +448,11 @@ public:
 	 */
 	bool blocking() const { return _flags & BLOCKING; }
 
+	/**
+	 * Check if the ring overwrites the oldest records (flight recorder)
+	 */
+	bool overwrites() const { return _flags & RECORDER; }
+
 	/**
 	 * Get the number of references to this ring
 	 */
@@ -326,16 +463,64 @@ public:
 	 */ 
 	uint64_t inc_seqnum() { return _seqnum++; }
 
+	/**
+	 * Acknowledge special records up to the specified sequence number.
+	 * Called by the reader once the records before it are written out.
+	 * Unlike record::ack() it does not touch the record slot, which
+	 * may have been reused by the time the ack is sent.
+	 */
+	void ack(uint64_t seq) { _ack_seqnum = seq + 1; }
+
+	/**
+	 * Check if the special record was acked.
+	 * Records carry only the low 52 bits of the seqnum, compare those.
+	 * @param seq sequence number of the special record
+	 */
+	bool acked(uint64_t seq) const { return (int64_t) ((_ack_seqnum - seq) << 12) > 0; }
+
 	/**
 	 * Increment drop count
 	 */ 
 	void inc_dropcnt() { _dropcnt++; }
 
+	/**
+	 * Check if the records may hold borrowed data (see arg_borrow).
+	 * Reader must release the data once it's done with each record.
+	 */
+	bool borrows() const { return _borrows; }
+
+	/**
+	 * Indicate that the records may hold borrowed data.
+	 * Writer's interface, must be called before the record is committed.
+	 */
+	void set_borrows() { _borrows = true; }
+
 	/**
 	 * Get the timestamp
 	 */
 	hogl::timestamp timestamp() const 
 	{
+		// Built-in clocks are read inline, custom timesources 
+		// go through the callback.
+		switch (_ts_clock) {
+		case timesource::REALTIME:
+			return timesource::read_clock(CLOCK_REALTIME);
+		case timesource::MONOTONIC:
+			return timesource::read_clock(CLOCK_MONOTONIC);
+		#if defined(CLOCK_REALTIME_COARSE) && defined(CLOCK_MONOTONIC_COARSE)
+		case timesource::REALTIME_COARSE:
+			return timesource::read_clock(CLOCK_REALTIME_COARSE);
+		case timesource::MONOTONIC_COARSE:
+			return timesource::read_clock(CLOCK_MONOTONIC_COARSE);
+		#endif
+		#if defined(__x86_64__)
+		case timesource::TSC:
+			return hogl::timestamp(__builtin_ia32_rdtsc());
+		#endif
+		default:
+			break;
+		}
+
 		hogl::timesource *ts = _timesource;
 		return ts->timestamp();
 	}
@@ -345,6 +530,99 @@ public:
 	 */
 	void timesource(hogl::timesource *ts);
 
+	/**
+	 * Get rate limiter state for this ring.
+	 * Allocated on first use. Writer's interface, must be called under the ring lock.
+	 */
+	hogl::limiter *limiter();
+
+	/**
+	 * Set mask overlay for this ring.
+	 * Sections enabled by the overlay are posted into this ring even if they are
+	 * disabled globally. Replaces the current overlay.
+	 * Writer's interface, shared rings are locked.
+	 * @param m mask
+	 */
+	void set_overlay(const hogl::mask &m);
+
+	/**
+	 * Remove mask overlay from this ring. Writer's interface.
+	 */
+	void clear_overlay();
+
+	/**
+	 * Get mask overlay
+	 * @return pointer to the overlay or null if the ring does not have one
+	 */
+	hogl::overlay* overlay() const
+	{
+		return _overlay;
+	}
+
+	/**
+	 * Enter overlay read-side section. Writer's interface.
+	 * The overlay returned by overlay() stays valid until overlay_read_unlock().
+	 * @return epoch index to pass to overlay_read_unlock()
+	 */
+	unsigned int overlay_read_lock() const
+	{
+		unsigned int i = _overlay_epoch & 1;
+		__sync_fetch_and_add(&_overlay_readers[i], 1);
+		return i;
+	}
+
+	/**
+	 * Leave overlay read-side section
+	 * @param i epoch index returned by overlay_read_lock()
+	 */
+	void overlay_read_unlock(unsigned int i) const
+	{
+		__sync_fetch_and_sub(&_overlay_readers[i], 1);
+	}
+
+	/**
+	 * Check if the ring has retired overlays waiting to be freed
+	 */
+	bool overlays_retired() const
+	{
+		return _overlay_retired || _overlay_retired_old;
+	}
+
+	/**
+	 * Free retired overlays that no writer can see anymore.
+	 * Reader's interface, does nothing if an overlay update is in progress.
+	 */
+	void reclaim_overlays();
+
+	/**
+	 * Attach flight recorder to this ring.
+	 * Sections enabled by the recorder's overlay are posted into the recorder
+	 * when they are disabled for this ring. The recorder can be attached only 
+	 * once and stays attached until the ring is destroyed.
+	 * @param r recorder ring (see RECORDER flag), the ring holds a reference to it
+	 * @return false if the ring already has a recorder
+	 */
+	bool recorder(ringbuf *r);
+
+	/**
+	 * Get flight recorder attached to this ring
+	 * @return pointer to the recorder or null if the ring does not have one
+	 */
+	ringbuf* recorder() const
+	{
+		return _recorder;
+	}
+
+	/**
+	 * Take a snapshot of the most recent records in the recorder ring.
+	 * Reader's interface. The writer keeps going while the records are copied,
+	 * the ones it overwrote in the meantime are not included.
+	 * @param buf buffer for the records (max * record_size() bytes)
+	 * @param max max number of records to copy
+	 * @return number of records copied (oldest first)
+	 */
+	unsigned int snapshot(uint8_t *buf, unsigned int max) const;
+
 	/**
 	 * Get timesource for this ring
 	 */
@@ -353,6 +631,15 @@ public:
 		return _timesource;
 	}
 
+	/**
+	 * Get activity object of the engine this ring is attached to
+	 * @return pointer to the activity object or null if the ring is not attached
+	 */
+	hogl::activity* engine_activity() const
+	{
+		return _activity;
+	}
+
 	/**
 	 * Hold a reference to ringbuf. Increments refcount.
 	 */
@@ -370,6 +657,13 @@ public:
 	{
 		int r = _refcnt.dec();
 		if (r < 0) abort();
+		if (r == 1) {
+			// Only the engine is left. Let it know so that
+			// the orphan is cleaned up.
+			activity *a = _activity;
+			if (a)
+				a->mark(_activity_slot);
+		}
 		if (r > 0) return;
 		if (!immortal())
 			delete this;
@@ -397,26 +691,35 @@ public:
 
 	/**
 	 * Block on full ring buffer. Writer's interface.
+	 * Spins for a short while and then parks until the reader frees some room.
+	 * Wakes up the engine before parking.
+	 * Spurious returns are possible, the caller must recheck the room.
+	 * @param want wait for more than this many free records
 	 */
-	void block()
-	{
-		pthread_mutex_lock(&_block_mutex);
-		_block_active = true;
-		pthread_cond_wait(&_block_cond, &_block_mutex);
-		pthread_mutex_unlock(&_block_mutex);
-	}
+	void block(unsigned int want = 0);
+
+	/**
+	 * Check if the writer is blocked. Reader's interface.
+	 */
+	bool blocked() const { return _block_waiters; }
 
 	/**
 	 * Unblock waiting writer (if any). Reader's interface.
+	 * Must be called after committing the head.
+	 * @return true if the writer was woken up
 	 */
-	void unblock()
+	bool unblock()
 	{
-		if (hogl_unlikely(_block_active)) {
-			pthread_mutex_lock(&_block_mutex);
-			pthread_cond_signal(&_block_cond);
-			_block_active = false;
-			pthread_mutex_unlock(&_block_mutex);
-		}
+		if (!blocking())
+			return false;
+
+		// Pairs with the barrier in block(). Either the writer sees 
+		// the new head or we see the waiter.
+		barrier::memrw();
+		if (hogl_likely(!_block_waiters))
+			return false;
+		wake_writer();
+		return true;
 	}
 
 	// -------- Writer interface ---------
@@ -433,20 +736,66 @@ public:
 	/**
 	 * Commit push transaction.
 	 * For non-blocking rings increments drop count if the ring is full,
-	 * otherwise blocks and waits for available room.
+	 * otherwise blocks and waits for available room. Recorder rings
+	 * overwrite the oldest record instead.
+	 * Only the critical records can use the reserved room.
 	 * Writer's interface.
+	 * @return false if the record was dropped
 	 */
-	void push_commit(bool bar = true)
+	bool push_commit(bool bar = true)
 	{
 		unsigned int t = _tail;
-		while (hogl_unlikely(_head == t)) {
+		while (hogl_unlikely(_head == t) || hogl_unlikely(reserved(t))) {
+			if (overwrites()) {
+				// Drop the oldest record. Head must move before its
+				// slot is reused, snapshot() depends on that.
+				_head = (t + 1) & _capacity;
+				barrier::memw();
+				break;
+			}
 			if (!blocking()) {
 				inc_dropcnt();
-				return;
+				return false;
 			}
-			block();
+			block(_head == t ? 0 : _reserve);
 		}
 		commit_tail((t + 1) & _capacity, bar);
+		return true;
+	}
+
+	/**
+	 * Reserve room for a batch of records. Writer's interface.
+	 * Room reserved for the critical records is not included.
+	 * Recorder rings do not support batching.
+	 * @param n number of records wanted
+	 * @return number of records that can be pushed without checking the room
+	 */
+	unsigned int push_reserve(unsigned int n) const
+	{
+		unsigned int r = room();
+		if (r <= _reserve || overwrites())
+			return 0;
+		r -= _reserve;
+		return r < n ? r : n;
+	}
+
+	/**
+	 * Begin push transaction for i-th record of the batch. Writer's interface.
+	 * @param i record index within the batch (must be less than push_reserve())
+	 * @return pointer to the record
+	 */
+	record *push_begin(unsigned int i)
+	{
+		return get_record((_tail + i) & _capacity);
+	}
+
+	/**
+	 * Commit batch of records with a single tail update. Writer's interface.
+	 * @param n number of records (must not exceed push_reserve())
+	 */
+	void push_commit_batch(unsigned int n, bool bar = true)
+	{
+		commit_tail((_tail + n) & _capacity, bar);
 	}
 
 	// -------- Reader interface ---------
@@ -572,6 +921,11 @@ public:
 	static void operator delete(void *p);
 
 private:
+	// Block spin limits
+	enum { MIN_BLOCK_SPIN = 16, MAX_BLOCK_SPIN = 4096 };
+
+	void wake_writer();
+
 	// No copies
 	ringbuf(const ringbuf&);
 	ringbuf& operator=( const ringbuf& );
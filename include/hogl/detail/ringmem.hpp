@@ -0,0 +1,144 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/detail/ringmem.hpp
+ * Ring memory allocator.
+ */
+#ifndef HOGL_DETAIL_RINGMEM_HPP
+#define HOGL_DETAIL_RINGMEM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <map>
+#include <vector>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/refcount.hpp>
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Ring memory allocator.
+ * Slab allocator for the ring record buffers with a limit on the total footprint.
+ * Buffer sizes are powers of two. Small buffers are carved out of the chunks
+ * dedicated to their size, large ones are allocated directly. Chunks are 
+ * returned to the system once all their buffers are freed.
+ * Reference counted, the rings hold a reference because they may outlive 
+ * the engine.
+ */
+class ringmem {
+public:
+	enum {
+		CHUNK_SHIFT = 18,
+		CHUNK_SIZE  = (1 << CHUNK_SHIFT)
+	};
+
+	/**
+	 * Create the allocator
+	 * @param limit max number of bytes allocated from the system (0 - unlimited)
+	 */
+	explicit ringmem(size_t limit = 0);
+
+	/**
+	 * Allocate record buffer
+	 * @param size size of the buffer in bytes (power of two)
+	 * @return pointer to the buffer or null if the limit was hit
+	 */
+	void *alloc(size_t size);
+
+	/**
+	 * Free record buffer
+	 * @param p pointer to the buffer
+	 * @param size size of the buffer in bytes
+	 */
+	void free(void *p, size_t size);
+
+	/**
+	 * Get the limit on the number of bytes allocated from the system (0 - unlimited)
+	 */
+	size_t limit() const { return _limit; }
+
+	/**
+	 * Get the number of bytes allocated from the system
+	 */
+	size_t reserved() const { return _reserved; }
+
+	/**
+	 * Get the number of bytes used by the record buffers
+	 */
+	size_t used() const { return _used; }
+
+	/**
+	 * Hold a reference
+	 */
+	ringmem *hold()
+	{
+		_refcnt.inc();
+		return this;
+	}
+
+	/**
+	 * Release a reference. Deletes the allocator once the last one is gone.
+	 */
+	void release()
+	{
+		if (_refcnt.dec() == 0)
+			delete this;
+	}
+
+private:
+	struct chunk {
+		uint8_t     *base;
+		void        *free;  // List of free buffers
+		unsigned int used;  // Number of buffers in use
+	};
+
+	pthread_mutex_t _mutex;
+	refcount        _refcnt;
+	size_t          _limit;
+	volatile size_t _reserved;
+	volatile size_t _used;
+
+	std::vector<chunk *>        _slab[CHUNK_SHIFT];  // Chunks for each size
+	std::map<uintptr_t, chunk*> _chunks;             // Chunk lookup by base address
+
+	~ringmem();
+
+	bool fits(size_t size) const { return !_limit || _reserved + size <= _limit; }
+
+	// No copies
+	ringmem(const ringmem&);
+	ringmem& operator=(const ringmem&);
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_DETAIL_RINGMEM_HPP
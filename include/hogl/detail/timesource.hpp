@@ -32,10 +32,13 @@
 #define HOGL_DETAIL_TIMESOURCE_HPP
 
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <hogl/detail/compiler.hpp>
 #include <hogl/detail/preproc.hpp>
 #include <hogl/detail/timestamp.hpp>
+#include <hogl/detail/barrier.hpp>
 
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
@@ -54,6 +57,47 @@ public:
 	// even need any context.
 	typedef hogl::timestamp (*callback)(const timesource *self);
 
+	// Calibration function.
+	// Raw timesources (CPU cycle counters for example) return timestamps in
+	// their own units. Conversion to nanoseconds is done by the engine
+	// when the records are flushed. Calibration function is called by the engine
+	// periodically and is expected to update the scale using set_scale().
+	typedef void (*calibrator)(timesource *self);
+
+	/**
+	 * Built-in clocks.
+	 * Rings read these inline instead of calling through the callback.
+	 */
+	enum builtin_clock {
+		CUSTOM = 0,
+		REALTIME,
+		MONOTONIC,
+		REALTIME_COARSE,
+		MONOTONIC_COARSE,
+		TSC
+	};
+
+	/**
+	 * Raw to nanoseconds conversion parameters.
+	 * nsec = base_nsec + ((raw - base_raw) * mult) >> SHIFT
+	 */
+	struct scale {
+		enum { SHIFT = 32 };
+		uint64_t base_raw;
+		uint64_t base_nsec;
+		uint64_t mult;
+	};
+
+	/**
+	 * Calibration point.
+	 * Calibrators keep the previous sample here to measure the rate.
+	 */
+	struct cal_point {
+		uint64_t raw;
+		uint64_t realtime;
+		uint64_t monotonic;
+	};
+
 	/// Get timestamp.
 	/// Calls the callback function to get the timestamp.
 	hogl::timestamp timestamp() const { return _callback(this); }
@@ -61,17 +105,73 @@ public:
 	/// Get the name of this timesource
 	const char *name() const { return _name; }
 
+	/// Get built-in clock id (CUSTOM for the user timesources)
+	builtin_clock builtin() const { return _builtin; }
+
+	/// Read built-in clock
+	static hogl_force_inline hogl::timestamp read_clock(clockid_t clk)
+	{
+		struct timespec ts;
+		clock_gettime(clk, &ts);
+		return hogl::timestamp(ts);
+	}
+
+	/// Check if this timesource generates raw timestamps
+	bool raw() const { return _calibrator != 0; }
+
+	/// Convert timestamp generated by this timesource to nanoseconds.
+	/// Noop for the regular timesources.
+	hogl::timestamp convert(hogl::timestamp t) const
+	{
+		if (!raw())
+			return t;
+		return convert_raw(t);
+	}
+
+	/// Update conversion parameters.
+	/// Timesource may be shared by several engines. Calibration is serialized
+	/// and skipped if the scale was refreshed within the last second.
+	/// @return true if the scale was updated
+	bool calibrate();
+
+	/// Get a consistent snapshot of the conversion parameters
+	scale get_scale() const;
+
+	/// Set conversion parameters. Used by the calibrators.
+	void set_scale(const scale &s);
+
+	/// Get the previous calibration point. Used by the calibrators.
+	/// Must be called only from the calibrator (see calibrate()).
+	cal_point& last_cal() { return _last_cal; }
+
 	/// Initialize callback object.
 	/// @param name timesource name
 	/// @param cb callback function pointer
-	timesource(const char *name, callback cb);
+	/// @param cal calibration function pointer (raw timesources only)
+	/// @param clk built-in clock implemented by the callback
+	timesource(const char *name, callback cb, calibrator cal = 0, builtin_clock clk = CUSTOM);
 	~timesource();
 
 	timesource(const timesource& ts);
 
 protected:
-	callback _callback;
-	char    *_name;
+	callback   _callback;
+	char      *_name;
+	calibrator _calibrator;
+	builtin_clock _builtin;
+
+	// Scale is updated by the engine and read by the engine and
+	// by the clients (rate limiter), seqcount protects the readers
+	// from the torn updates.
+	volatile unsigned int _scale_seq;
+	scale      _scale;
+
+	// Calibrator state, protected by the calibration mutex
+	pthread_mutex_t _cal_mutex;
+	cal_point  _last_cal;
+
+	hogl::timestamp convert_raw(hogl::timestamp t) const;
+	bool fresh(const scale &s) const;
 };
 
 } // namespace hogl
@@ -59,11 +59,17 @@ private:
 	unsigned int _capacity;
 	entry       *_entry;
 
-	// Less operator for sorting
+	// Less operator for sorting.
+	// Records with the same timestamp (coarse clocks, batches that share
+	// a timestamp) are kept in the ring order.
 	struct less {
 		bool operator() (const entry &i, const entry &j)
 		{
-			return i.timestamp < j.timestamp;
+			if (hogl_likely(!(i.timestamp == j.timestamp)))
+				return i.timestamp < j.timestamp;
+			if (i.tag != j.tag)
+				return i.tag < j.tag;
+			return i.rec->seqnum < j.rec->seqnum;
 		}
 	};
 	static less _less;
@@ -91,20 +91,66 @@ public:
 		unsigned int len() const { return TS_LEN; }
 	};
 
+	// Date/time cache (MMDDYYYY HH:MM:SS.nnnnnnnnn).
+	// Calendar part is regenerated only when the second changes.
+	struct dtcache {
+		enum {
+			NSEC_SPLIT  = 10000,
+			NSEC_HI_LEN = 5,
+			NSEC_LEN    = 9,
+			NSEC_LO_LEN = NSEC_LEN - NSEC_HI_LEN,
+			DT_LEN      = 17,
+			TS_LEN      = DT_LEN + 1 + NSEC_LEN,
+			NSEC_HI_OFFSET = DT_LEN + 1,
+			NSEC_LO_OFFSET = NSEC_HI_OFFSET + NSEC_HI_LEN
+		};
+
+		time_t   _sec;
+		uint32_t _nsec_hi;
+		uint8_t  _str[TS_LEN];
+
+		dtcache(): _sec(-1), _nsec_hi(0)
+		{
+			for (unsigned i=0; i<TS_LEN; i++) _str[i]='0';
+			_str[DT_LEN] = '.';
+		}
+
+		void update(hogl::timestamp t);
+		const char *str() const  { return (const char *) _str; }
+		unsigned int len() const { return TS_LEN; }
+
+	private:
+		void update_datetime(time_t sec);
+	};
+
 	// Expanded record data
 	struct record_data {
 		const hogl::record* record;
+		hogl::timestamp timestamp;
 		const char*  area_name;
 		const char*  sect_name;
 		const char*  ring_name;
+		const char*  area_sect;     // pre-rendered "AREA:SECTION "
+		unsigned int area_name_len;
+		unsigned int sect_name_len;
+		unsigned int ring_name_len;
+		unsigned int area_sect_len;
 		const char*  arg_str[record::NARGS];
 		unsigned int next_arg;
 	};
 
 protected:
+	// Header writer. One specialized version is generated for each
+	// combination of fields and selected at construction time.
+	typedef void (format_basic::*header_fn)(ostrbuf& sb, record_data& d);
+
+	enum { FIELDS_MASK = (TIMESPEC | TIMESTAMP | TIMEDELTA | RING | SEQNUM | AREA | SECTION) };
+
 	uint32_t  _fields;
+	header_fn _header;
 	timestamp _last_timestamp;
 	tscache   _tscache;
+	dtcache   _dtcache;
 
 	virtual void output_plain(hogl::ostrbuf& sb, record_data& d);
 	virtual void output_raw(hogl::ostrbuf& sb, record_data& d);
@@ -114,6 +160,10 @@ protected:
 	void flexi_header(ostrbuf& sb, record_data& d);
 	void fast0_header(ostrbuf& sb, record_data& d);
 	void fast1_header(ostrbuf& sb, record_data& d);
+
+	template<uint32_t F> void header(ostrbuf& sb, record_data& d);
+	template<uint32_t F> static void fill_header_table(header_fn *t);
+	static header_fn header_writer(uint32_t fields);
 };
 
 } // namespace hogl
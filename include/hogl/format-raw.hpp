@@ -42,9 +42,24 @@ namespace hogl {
  */
 class format_raw : public format {
 public:
-	format_raw();
+	/**
+	 * Format flags
+	 */
+	enum {
+		LONG_STRINGS = (1<<0) /// 32bit string lengths (RAW v1.2, hogl-cook -v 1.2)
+	};
+
+	/**
+	 * Create raw format handler.
+	 * Default output is RAW v1.1, strings are cut at 64KB.
+	 * @param flags format flags
+	 */
+	format_raw(unsigned int flags = 0);
 
 	virtual void process(ostrbuf &s, const format::data &d);
+
+private:
+	unsigned int _flags;
 };
 
 } // namespace hogl
@@ -33,6 +33,7 @@
 
 #include <hogl/detail/mask.hpp>
 #include <hogl/detail/engine.hpp>
+#include <hogl/tls.hpp>
 
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
@@ -48,6 +49,25 @@ static inline void apply_mask(const mask &m)
 	default_engine->apply_mask(m);
 }
 
+/**
+ * Set mask overlay for the calling thread.
+ * Sections enabled by the overlay are posted by this thread (into its TLS ring)
+ * even if they are disabled globally. Other threads are not affected.
+ * @param m mask reference
+ */
+static inline void set_overlay(const mask &m)
+{
+	tls::ring()->set_overlay(m);
+}
+
+/**
+ * Remove mask overlay of the calling thread
+ */
+static inline void clear_overlay()
+{
+	tls::ring()->clear_overlay();
+}
+
 } // namespace hogl
 __HOGL_PRIV_NS_CLOSE__
 
@@ -0,0 +1,134 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file hogl/percpu.hpp
+ * Per-CPU rings.
+ */
+#ifndef HOGL_PERCPU_HPP
+#define HOGL_PERCPU_HPP
+
+#include <sched.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <hogl/detail/compiler.hpp>
+#include <hogl/detail/ringbuf.hpp>
+#include <hogl/engine.hpp>
+
+// The kernel keeps the current CPU id in the rseq area registered by glibc (2.35+).
+// Reading it is much cheaper than the sched_getcpu() call.
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35)) && \
+	(defined(__x86_64__) || defined(__aarch64__))
+#include <sys/rseq.h>
+#define HOGL_PERCPU_RSEQ 1
+#endif
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+/**
+ * Per-CPU ring set.
+ * One shared ring per CPU. Threads that use the set post into the ring of 
+ * the CPU they're running on. The ring lock is only contended if a thread 
+ * gets preempted or migrated in the middle of a post.
+ * Memory footprint and the number of rings the engine has to scan depend 
+ * on the number of CPUs rather than the number of threads.
+ */
+class percpu {
+private:
+	engine       *_engine;
+	ringbuf     **_rings;
+	unsigned int  _count;
+
+	// No copies
+	percpu(const percpu&);
+	percpu& operator=( const percpu& );
+
+public:
+	/**
+	 * Allocate and register per-CPU rings.
+	 * Rings are named <name>.CPU<n>. SHARED flag is set automatically.
+	 */
+	percpu(const char *name,
+		const ringbuf::options &opts = ringbuf::default_options,
+		engine *engine = default_engine);
+
+	/**
+	 * Release per-CPU rings.
+	 * @warn The threads that use this set must be done with it.
+	 */
+	~percpu();
+
+	/**
+	 * Check if all the rings were allocated correctly
+	 */
+	bool valid() const { return _rings != nullptr; }
+
+	/**
+	 * Get number of rings in the set
+	 */
+	unsigned int count() const { return _count; }
+
+	/**
+	 * Get the ring of a specific CPU
+	 */
+	ringbuf *ring(unsigned int cpu) const
+	{
+		return _rings[cpu < _count ? cpu : cpu % _count];
+	}
+
+	/**
+	 * Get the ring of the current CPU
+	 */
+	ringbuf *ring() const { return ring(cpu()); }
+
+	/**
+	 * Get the id of the CPU the caller is running on
+	 */
+	static unsigned int cpu()
+	{
+	#if defined(HOGL_PERCPU_RSEQ)
+		void *tp;
+		#if defined(__x86_64__)
+		asm ("mov %%fs:0, %0" : "=r" (tp));
+		#else
+		asm ("mrs %0, tpidr_el0" : "=r" (tp));
+		#endif
+		const volatile struct rseq *rs = (const volatile struct rseq *) ((uint8_t *) tp + __rseq_offset);
+		int id = (int) rs->cpu_id;
+		if (hogl_likely(__rseq_size && id >= 0))
+			return id;
+	#endif
+		int c = sched_getcpu();
+		return c < 0 ? 0 : c;
+	}
+};
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
+
+#endif // HOGL_PERCPU_HPP
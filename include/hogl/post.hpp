@@ -46,85 +46,117 @@ namespace hogl {
 /**
  * Push a log record without locking
  */
+template<typename... A>
 static hogl_force_inline void push_unlocked(ringbuf *ring,
-		const hogl::area *area,	unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area,	unsigned int sect, const A&... a)
 {
-	argpack ap;
-	unsigned int n = ap.populate(__hogl_short_arg_list(16));
-
 	// Check whether we have complex arguments (cstr, hexdump, etc).
-	// If not then populate the record directly inline, otherwise use 
-	// the argpack to move all processing out of line.
+	// If not then populate the record directly inline, otherwise move
+	// all processing out of line.
 	// This is resolved at compile time and does not generate any
 	// extra code.
-	if (!n) {
-		record *r = post_impl::begin_unlocked(ring, area, sect);
-		r->set_args(ring->record_tailroom(), __hogl_short_arg_list(16));
-		post_impl::finish_unlocked(ring);
-	} else
-		post_impl::unlocked(ring, area, sect, ap);
+	post_impl::push_unlocked(post_impl::simple_args<A...>(), ring, area, sect, a...);
 }
 
 /**
  * Push a log record into the ring
  */
+template<typename... A>
 static hogl_force_inline void push(ringbuf *ring,
-		const hogl::area *area,	unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area,	unsigned int sect, const A&... a)
 {
-	argpack ap;
-	unsigned int n = ap.populate(__hogl_short_arg_list(16));
+	// See push_unlocked()
+	post_impl::push_locked(post_impl::simple_args<A...>(), ring, area, sect, a...);
+}
 
-	// Check whether we have complex arguments (cstr, hexdump, etc).
-	// If not then populate the record directly inline, otherwise use 
-	// the argpack to move all processing out of line.
-	// This is resolved at compile time and does not generate any
-	// extra code.
-	if (!n) {
-		record *r = post_impl::begin_locked(ring, area, sect);
-		r->set_args(ring->record_tailroom(), __hogl_short_arg_list(16));
-		post_impl::finish_locked(ring);
+/**
+ * Check if the record should be posted.
+ * Mask overlays, rate limits and sampling are checked out of line and only 
+ * for the rings and sections that have them configured.
+ */
+static hogl_force_inline bool enabled(ringbuf *ring, const hogl::area *area, unsigned int sect)
+{
+	return (area->test(sect) || (hogl_unlikely(ring->overlay() != 0) && post_impl::overlaid(ring, area, sect))) &&
+		(hogl_likely(!area->limited(sect)) || post_impl::admit(ring, area, sect));
+}
+
+/**
+ * Push a log record into the flight recorder of the ring.
+ * Called only for the rings that have a recorder and only when the section 
+ * is disabled for the ring itself. Everything is done out of line.
+ */
+template<typename... A>
+static hogl_force_inline void push_recorder(ringbuf *ring,
+		const hogl::area *area, unsigned int sect, const A&... a)
+{
+	if (post_impl::recorded(ring, area, sect)) {
+		argpack<sizeof...(A)> ap;
+		uint64_t type = ap.populate(a...);
+		post_impl::locked(ring->recorder(), area, sect, type, ap.item);
 	} else
-		post_impl::locked(ring, area, sect, ap);
+		post_impl::discard(post_impl::borrowed_args<A...>(), a...);
+}
+
+/**
+ * Skip a log record that is not posted.
+ * Borrowed data (if any) is released.
+ */
+template<typename... A>
+static hogl_force_inline void skip(ringbuf *ring,
+		const hogl::area *area, unsigned int sect, const A&... a)
+{
+	if (hogl_unlikely(ring->recorder() != 0))
+		push_recorder(ring, area, sect, a...);
+	else
+		post_impl::discard(post_impl::borrowed_args<A...>(), a...);
 }
 
 /**
  * Post new log record
  */
+template<typename... A>
 static hogl_force_inline void post(ringbuf *ring,
-		const hogl::area *area, unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area, unsigned int sect, const A&... a)
 {
-	if (area->test(sect))
-		push(ring, area, sect, __hogl_short_arg_list(16));
+	if (enabled(ring, area, sect))
+		push(ring, area, sect, a...);
+	else
+		skip(ring, area, sect, a...);
 }
 
 /**
  * Post new log record into the TLS ring
  */
+template<typename... A>
 static hogl_force_inline void post(
-		const hogl::area *area, unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area, unsigned int sect, const A&... a)
 {
-	post(tls::ring(), area, sect, __hogl_short_arg_list(16));
+	post(tls::ring(), area, sect, a...);
 }
 
 /**
  * Post new log record without locking.
  * The ring must not be shared.
  */
+template<typename... A>
 static hogl_force_inline void post_unlocked(ringbuf *ring,
-		const hogl::area *area, unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area, unsigned int sect, const A&... a)
 {  
-	if (area->test(sect))
-		push_unlocked(ring, area, sect, __hogl_short_arg_list(16));
+	if (enabled(ring, area, sect))
+		push_unlocked(ring, area, sect, a...);
+	else
+		skip(ring, area, sect, a...);
 }
 
 /**
  * Post new log record into the TLS ring without locking. 
  * The TLS ring must not be shared.
  */
+template<typename... A>
 static hogl_force_inline void post_unlocked(
-		const hogl::area *area, unsigned int sect, __hogl_long_arg_list(16))
+		const hogl::area *area, unsigned int sect, const A&... a)
 {
-	post_unlocked(tls::ring(), area, sect, __hogl_short_arg_list(16));
+	post_unlocked(tls::ring(), area, sect, a...);
 }
 
 } // namespace hogl
@@ -73,6 +73,29 @@ static inline ringbuf *find_ring(const std::string &name)
 	return default_engine->find_ring(name.c_str());
 }
 
+/**
+ * Attach flight recorder to the ring.
+ * Sections enabled by the mask are recorded when they are disabled for the ring
+ * and dumped to the output only when a trigger fires.
+ * @param ring ring to attach the recorder to
+ * @param m mask that selects recorded sections
+ * @param opts recorder ring options
+ * @return false if the ring already has a recorder or the allocation failed
+ */
+static inline bool add_recorder(ringbuf *ring, const mask &m, const ringbuf::options &opts)
+{
+	return default_engine->add_recorder(ring, m, opts);
+}
+
+/**
+ * Dump flight recorders of the default engine.
+ * Async signal safe.
+ */
+static inline void dump_recorders()
+{
+	default_engine->dump_recorders();
+}
+
 /**
  * Get a list of ringbufs from the default engine
  * @param l reference to a stringlist
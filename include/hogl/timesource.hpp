@@ -47,6 +47,26 @@ extern timesource realtime_timesource;
  */
 extern timesource monotonic_timesource;
 
+/**
+ * Coarse realtime clock timesource.
+ * Lower resolution (typically a scheduler tick) but cheaper to read.
+ * Same as realtime on the platforms without coarse clocks.
+ */
+extern timesource realtime_coarse_timesource;
+
+/**
+ * Coarse monotonic clock timesource.
+ * Same as monotonic on the platforms without coarse clocks.
+ */
+extern timesource monotonic_coarse_timesource;
+
+/**
+ * CPU timestamp counter timesource.
+ * Generates raw TSC values which are converted to the wall time by the engine.
+ * Same as realtime on the platforms without invariant TSC.
+ */
+extern timesource tsc_timesource;
+
 /**
  * Default timesource (same as realtime on most platforms)
  * Weak symbol. Can be overriden by user app.
@@ -36,6 +36,7 @@
 
 #include <hogl/detail/ringbuf.hpp>
 #include <hogl/engine.hpp>
+#include <hogl/percpu.hpp>
 
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
@@ -51,6 +52,11 @@ private:
 	 */
 	static thread_local ringbuf *_ring;
 
+	/**
+	 * Per thread pointer to the per-CPU ring set (if used)
+	 */
+	static thread_local percpu *_percpu;
+
 	/**
 	 * Pointer to the engine serving this TLS
 	 */ 
@@ -66,6 +72,12 @@ private:
 	 */
 	ringbuf *_current_ring;
 
+	/**
+	 * Pointers to the previous and current per-CPU ring sets
+	 */
+	percpu *_previous_percpu;
+	percpu *_current_percpu;
+
 	// No copies
 	tls(const tls&);
 	tls& operator=( const tls& );
@@ -95,6 +107,13 @@ public:
  	 */
 	tls(ringbuf *r, engine *engine = default_engine);
 
+	/**
+	 * Setup hogl per thread settings.
+	 * This constructor makes the thread post into the per-CPU rings.
+	 * If the set is not valid the thread keeps using the current ring.
+ 	 */
+	tls(percpu &p, engine *engine = default_engine);
+
 	/**
 	 * Cleanup per thread settings.
 	 */
@@ -103,15 +122,28 @@ public:
 	/**
 	 * Check if tls (ring, etc) was allocated correctly
 	 */
-	bool valid() const { return _current_ring != nullptr; }
+	bool valid() const { return _current_ring != nullptr || _current_percpu != nullptr; }
 
 	/**
 	 * Get pointer to the ring of the current thread
 	 */
 #if !defined(__QNXNTO__)
-	static ringbuf *ring() { return _ring; }
+	static ringbuf *ring()
+	{
+		percpu *p = _percpu;
+		if (hogl_unlikely(p != nullptr))
+			return p->ring();
+		return _ring;
+	}
+
+	/**
+	 * Get pointer to the per-CPU ring set of the current thread
+	 * @return null if the thread does not use per-CPU rings
+	 */
+	static percpu *cpu_rings() { return _percpu; }
 #else
 	static ringbuf *ring();
+	static percpu *cpu_rings();
 #endif
 };
 
@@ -0,0 +1,87 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hogl/detail/activity.hpp"
+#include "hogl/detail/barrier.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+activity::activity() : _nslots(0), _wake_seq(0), _sleeping(0), _ack_seq(0), _ack_waiters(0)
+{
+	memset(_seg, 0, sizeof(_seg));
+}
+
+activity::~activity()
+{
+	for (unsigned int i = 0; i < MAX_SEGS; i++)
+		::free(_seg[i]);
+}
+
+void activity::sleep(int seq, unsigned int usec)
+{
+	_sleeping = 1;
+	barrier::memrw();
+	futex::wait(&_wake_seq, seq, usec);
+	_sleeping = 0;
+}
+
+unsigned int activity::alloc()
+{
+	if (!_free.empty()) {
+		unsigned int slot = _free.back();
+		_free.pop_back();
+		return slot;
+	}
+
+	if (_nslots == MAX_SEGS * SEG_BITS)
+		return NOSLOT;
+
+	unsigned int s = _nslots / SEG_BITS;
+	if (!_seg[s]) {
+		void *m;
+		if (posix_memalign(&m, 64, sizeof(line) * SEG_LINES))
+			return NOSLOT;
+		memset(m, 0, sizeof(line) * SEG_LINES);
+
+		// Make sure the segment is cleared before it's published
+		barrier::memw();
+		_seg[s] = (line *) m;
+	}
+
+	return _nslots++;
+}
+
+void activity::free(unsigned int slot)
+{
+	_free.push_back(slot);
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
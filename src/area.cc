@@ -35,6 +35,7 @@
 #include <sstream>
 
 #include "hogl/detail/area.hpp"
+#include "hogl/detail/barrier.hpp"
 #include "hogl/fmt/printf.h"
 
 #ifdef HOGL_DEBUG
@@ -70,6 +71,17 @@ area::area(const char *name, const char **section) :
 
 	_bitmap.reset();
 
+	_limited.resize(_bitmap.size());
+	_limited.reset();
+	_limit = 0;
+
+	_critical.resize(_bitmap.size());
+	_critical.reset();
+
+	_prefix = 0;
+	_prefix_off = 0;
+	update_names();
+
 	dprint("created area %p. name %s size %u", (void*)this, _name, _bitmap.size());	
 }
 
@@ -80,6 +92,10 @@ area::~area()
 
 	free(_name);
 
+	delete [] _prefix;
+	delete [] _prefix_off;
+	delete [] _limit;
+
 	if (_section != default_section_names) {
 		for (i=0; i < _bitmap.size(); ++i)
 			free((void *) _section[i]);
@@ -87,6 +103,61 @@ area::~area()
 	}
 }
 
+// Set section rate limit.
+// Limits array is allocated on first use and is never freed while the
+// area is alive, because the post path may be reading it.
+void area::set_limit(unsigned int s, const limit &l)
+{
+	if (s >= _bitmap.size())
+		return;
+
+	if (!l.active()) {
+		_limited.reset(s);
+		if (_limit)
+			_limit[s] = l;
+		return;
+	}
+
+	if (!_limit) {
+		limit *nl = new limit[_bitmap.size()];
+		memset(nl, 0, sizeof(limit) * _bitmap.size());
+		barrier::memw();
+		_limit = nl;
+	}
+
+	_limit[s] = l;
+	barrier::memw();
+	_limited.set(s);
+}
+
+// Update cached name lengths and pre-rendered "AREA:SECTION " strings.
+void area::update_names()
+{
+	delete [] _prefix;
+	delete [] _prefix_off;
+
+	_name_len = strlen(_name);
+	_prefix_off = new unsigned int [_bitmap.size() + 1];
+
+	unsigned int i, plen = 0;
+	for (i=0; i < _bitmap.size(); ++i) {
+		_prefix_off[i] = plen;
+		plen += _name_len + strlen(_section[i]) + 2;
+	}
+	_prefix_off[i] = plen;
+
+	_prefix = new char [plen + 1];
+	for (i=0; i < _bitmap.size(); ++i) {
+		char *p = _prefix + _prefix_off[i];
+		unsigned int slen = _prefix_off[i + 1] - _prefix_off[i] - _name_len - 2;
+		memcpy(p, _name, _name_len); p += _name_len;
+		*p++ = ':';
+		memcpy(p, _section[i], slen); p += slen;
+		*p++ = ' ';
+	}
+	_prefix[plen] = '\0';
+}
+
 bool area::operator== (const area &area) const
 {
 	if (strcmp(name(), area.name()))
@@ -0,0 +1,125 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hogl/detail/arena.hpp"
+#include "hogl/detail/barrier.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+enum { 
+	MIN_SIZE = 4096,
+	MAX_SIZE = (1U << 30)
+};
+
+arena::arena(unsigned int size) :
+	_buf(0), _mask(0), _head(0), _tail(0)
+{
+	unsigned int s = MIN_SIZE;
+	while (s < size && s < MAX_SIZE)
+		s <<= 1;
+
+	if (posix_memalign((void **) &_buf, sysconf(_SC_PAGESIZE), s))
+		_buf = 0;
+	else
+		_mask = s - 1;
+}
+
+arena::~arena()
+{
+	free(_buf);
+}
+
+uint8_t *arena::alloc(uint64_t seqnum, unsigned int len)
+{
+	if (!_buf || len > _mask)
+		return 0;
+
+	unsigned int need = (sizeof(chunk) + len + 15) & ~15U;
+	unsigned int h = _head;
+	unsigned int o = h & _mask;
+
+	// Chunks are contiguous. Pad to the end of the buffer if the chunk 
+	// does not fit and start from the top.
+	unsigned int pad = 0;
+	if (o + need > _mask + 1)
+		pad = _mask + 1 - o;
+
+	// Reader frees the space by moving the tail
+	if ((h - _tail) + pad + need > _mask + 1)
+		return 0;
+
+	chunk *c;
+	if (pad) {
+		c = (chunk *) (_buf + o);
+		c->seqnum = seqnum;
+		c->size   = pad;
+		o = 0;
+	}
+
+	c = (chunk *) (_buf + o);
+	c->seqnum = seqnum;
+	c->size   = need;
+
+	// Chunk headers must be visible before the head moves.
+	// The data itself is published with the record.
+	barrier::memw();
+	_head = h + pad + need;
+
+	return (uint8_t *) (c + 1);
+}
+
+void arena::release(uint64_t seqnum)
+{
+	unsigned int h = _head;
+	unsigned int t = _tail;
+
+	// Read the head before the chunk headers
+	barrier::memr();
+
+	while (t != h) {
+		const chunk *c = (const chunk *) (_buf + (t & _mask));
+
+		// Stop at the first chunk that belongs to a newer record.
+		// Sequence numbers are 52 bits wide (see record::seqnum).
+		if ((int64_t) ((c->seqnum - seqnum) << 12) > 0)
+			break;
+		t += c->size;
+	}
+
+	// Make sure that we finished reading the data before the
+	// writer can reuse the space
+	barrier::memr();
+	_tail = t;
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -228,6 +228,10 @@ extern "C" hogl_tls_t hogl_new_tls(const char *name, struct hogl_tls_options *_o
 	opts.prio     = _opts->ring_priority;
 	opts.record_tailroom = _opts->record_tailroom ? _opts->record_tailroom : 80;
 	opts.flags    = 0;
+	opts.budget   = 0;
+	opts.max_latency_usec = 0;
+	opts.reserve  = 0;
+	opts.arena_size = 0;
 
 	hogl::tls *tls = new hogl::tls(name, opts);
 
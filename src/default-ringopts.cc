@@ -39,7 +39,11 @@ ringbuf::options hogl_weak_symbol default_ring_options = {
 	.capacity = 2048,
 	.prio = 0,
 	.flags = ringbuf::SHARED | ringbuf::IMMORTAL,
-	.record_tailroom = 80
+	.record_tailroom = 80,
+	.budget = 0,
+	.max_latency_usec = 0,
+	.reserve = 0,
+	.arena_size = 0
 };
 
 } // namespace hogl
@@ -45,7 +45,7 @@ static hogl::timestamp clock_realtime(const hogl::timesource *)
 	return hogl::timestamp(ts);
 }
 
-timesource realtime_timesource("clock_realtime", clock_realtime);
+timesource realtime_timesource("clock_realtime", clock_realtime, 0, timesource::REALTIME);
 
 #if !defined(__QNXNTO__)
 static hogl::timestamp clock_monotonic(const hogl::timesource *)
@@ -54,6 +54,8 @@ static hogl::timestamp clock_monotonic(const hogl::timesource *)
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	return hogl::timestamp(ts);
 }
+
+#define MONOTONIC_CLOCK timesource::MONOTONIC
 #else
 static hogl::timestamp clock_monotonic(const hogl::timesource *)
 {
@@ -71,14 +73,39 @@ static hogl::timestamp clock_monotonic(const hogl::timesource *)
 
 	return hogl::timestamp(nsec);
 }
+
+#define MONOTONIC_CLOCK timesource::CUSTOM
 #endif
 
-timesource monotonic_timesource("clock_monotonic", clock_monotonic);
+timesource monotonic_timesource("clock_monotonic", clock_monotonic, 0, MONOTONIC_CLOCK);
+
+#if defined(CLOCK_REALTIME_COARSE) && defined(CLOCK_MONOTONIC_COARSE)
+static hogl::timestamp clock_realtime_coarse(const hogl::timesource *)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return hogl::timestamp(ts);
+}
+
+static hogl::timestamp clock_monotonic_coarse(const hogl::timesource *)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return hogl::timestamp(ts);
+}
+
+timesource realtime_coarse_timesource("clock_realtime_coarse", clock_realtime_coarse, 0, timesource::REALTIME_COARSE);
+timesource monotonic_coarse_timesource("clock_monotonic_coarse", clock_monotonic_coarse, 0, timesource::MONOTONIC_COARSE);
+#else
+// Coarse clocks are not available. Use the regular ones.
+timesource realtime_coarse_timesource("clock_realtime", clock_realtime, 0, timesource::REALTIME);
+timesource monotonic_coarse_timesource("clock_monotonic", clock_monotonic, 0, MONOTONIC_CLOCK);
+#endif
 
 /**
  * Default timesource instance
  */
-timesource hogl_weak_symbol default_timesource("clock_realtime", clock_realtime);
+timesource hogl_weak_symbol default_timesource("clock_realtime", clock_realtime, 0, timesource::REALTIME);
 
 } // namespace hogl
 __HOGL_PRIV_NS_CLOSE__
@@ -33,12 +33,13 @@
 #include <sys/time.h>
 
 #include <string>
-#include <map>
 #include <algorithm>
 #include <stdexcept>
 
 #include "hogl/detail/internal.hpp"
 #include "hogl/detail/engine.hpp"
+#include "hogl/detail/limiter.hpp"
+#include "hogl/detail/overlay.hpp"
 #include "hogl/detail/barrier.hpp"
 #include "hogl/platform.hpp"
 #include "hogl/post.hpp"
@@ -55,12 +56,18 @@ namespace hogl {
 
 // Defaults for engine options
 engine::options engine::default_options = {
-	.default_mask = hogl::mask(".*:(INFO|WARN|ERROR|FATAL).*", 0), // enable default sections in all areas
+	.default_mask = hogl::mask(".*:(INFO|WARN).*", ".*:(ERROR|FATAL).*@critical", 0), // enable default sections in all areas
 	.polling_interval_usec = 10000,           // polling interval usec
 	.tso_buffer_capacity =   4096,            // tso buffer size (number of records)
 	.features = 0,                            // default feature set
 	.schedparam = 0,                          // schedparam for this engine (0 means default params)
 	.timesource = 0,                          // timesource for this engine (0 means default timesource)
+	.unblock_threshold = 64,                  // wake blocked writers every 64 records
+	.recorder_trigger = hogl::mask(".*:(ERROR|FATAL).*", 0), // dump flight recorders on errors
+	.recorder_depth = 0,                      // dump everything the recorders have got
+	.recorder_window_usec = 0,                // regardless of the age
+	.ring_pool_size = 8,                      // keep up to 8 orphaned rings for reuse
+	.ring_memory_limit = 0,                   // no limit on the ring memory
 };
 
 /**
@@ -83,15 +90,31 @@ void engine::add_internal_area()
 	_internal_area->enable(internal::ERROR);
 	_internal_area->enable(internal::DROPMARK);
 	_internal_area->enable(internal::TSOFULLMARK);
+	_internal_area->enable(internal::SUPPRESSMARK);
+	_internal_area->enable(internal::CALIBMARK);
+	_internal_area->enable(internal::DUMPMARK);
 
-	_area_map.insert(area_map::value_type(name, _internal_area));
+	_area_map.insert(_internal_area);
 	_mask.apply(_internal_area);
 }
 
 extern timesource default_timesource;
 
+// Drop engine's reference to the ring removed from the ring map
+static void release_ring(ringbuf *r)
+{
+	r->release();
+}
+
 engine::engine(output &out, const engine::options &opts) :
 	_magic(hogl::engine_magic),
+	_ring_map(release_ring),
+	_dump_requested(false),
+	_dump_pending(false),
+	_dump_area(0),
+	_dump_sect(0),
+	_suppressed_ts(0),
+	_calib_base(0),
 	_running(false),
 	_killed(false),
 	_output(out),
@@ -99,13 +122,13 @@ engine::engine(output &out, const engine::options &opts) :
 {
 	int err;
 
-	// Do we need prio inheritance on these?
-	pthread_mutex_init(&_area_mutex, NULL);
-	pthread_mutex_init(&_ring_mutex, NULL);
+	pthread_mutex_init(&_mask_mutex, NULL);
+	pthread_mutex_init(&_pool_mutex, NULL);
 
-	_ring_index.dirty = true;
-	_ring_index.count = 0;
-	_ring_index.entries = 0;
+	_ring_index.init();
+
+	_trigger = new overlay(_opts.recorder_trigger);
+	_ringmem = new ringmem(_opts.ring_memory_limit);
 
 	_timesource = _opts.timesource;
 	if (!_timesource)
@@ -119,10 +142,13 @@ engine::engine(output &out, const engine::options &opts) :
 	}
 
 	memset(&_stats, 0, sizeof(_stats));
+	_backlog = false;
 
 	_mask = opts.default_mask;
 	add_internal_area();
 
+	calibrate_timesource();
+
 	dprint("created engine %p", (void*)this);
 
 	// Start engine thread
@@ -139,18 +165,34 @@ engine::~engine()
 	pthread_join(_thread, NULL);
 
 	// Release all registered rings
-	for (ring_map::iterator it = _ring_map.begin(); it != _ring_map.end(); ++it) {
-		ringbuf *r = it->second;
-		r->release();
+	{
+		ring_map::reader rr(_ring_map);
+		for (unsigned int i = 0; i < rr->count; i++)
+			rr->items[i]->release();
 	}
 
+	// Release recycled rings
+	for (unsigned int i = 0; i < _ring_index.retired.size(); i++)
+		_ring_index.retired[i]->release();
+	for (unsigned int i = 0; i < _ring_pool.size(); i++)
+		_ring_pool[i]->release();
+	_ring_pool.clear();
+
 	// Release all registered areas
-	for (area_map::iterator it = _area_map.begin(); it != _area_map.end(); ++it) {
-		area *a = it->second;
-		delete a;
+	{
+		area_map::reader ar(_area_map);
+		for (unsigned int i = 0; i < ar->count; i++)
+			delete ar->items[i];
 	}
 
-	delete [] _ring_index.entries;
+	pthread_mutex_destroy(&_mask_mutex);
+	pthread_mutex_destroy(&_pool_mutex);
+
+	_ring_index.destroy();
+	delete _trigger;
+
+	// Rings that outlive the engine keep the allocator around
+	_ringmem->release();
 
 	dprint("destroyed engine %p", (void*)this);
 }
@@ -175,69 +217,242 @@ void *engine::entry(void *_self)
 	return 0;
 }
 
-// For whatever reason this cannot be inside of the rebuild_ring_index
-// function below. GCC barfs on the std::sort() call in that case.
-struct _ring_sorter {
-	bool operator() (const engine::ring_index::entry &i, const engine::ring_index::entry &j) 
-	{
-		return i.pit.const_ring()->prio() > j.pit.const_ring()->prio();
-	}
-} ring_sorter;
+void engine::ring_index::init()
+{
+	entries  = 0;
+	count    = 0;
+	capacity = 0;
+	dead     = 0;
+	added    = 0;
+	dirty    = false;
+	noslot   = 0;
+	full     = true;
+	min_latency = 0;
+	slot_pos.clear();
+	active.clear();
+	recorders.clear();
+	retired.clear();
+}
 
-// Look up the ring in the index and get the seqnum 
-engine::ring_index::entry* engine::ring_index::operator() (ringbuf *ring)
+void engine::ring_index::destroy()
 {
-	for (unsigned int i=0; i < this->count; i++) {
-		if (this->entries[i].pit.ring() == ring)
-			return &this->entries[i];
+	pending *p = added;
+	while (p) {
+		pending *n = p->next;
+		delete p;
+		p = n;
 	}
-	return 0;
+
+	// Rings may outlive the engine, detach them from the activity bitmap
+	for (unsigned int i = 0; i < count; i++) {
+		if (entries[i].pit.valid())
+			entries[i].pit.ring()->_activity = 0;
+	}
+
+	delete [] entries;
+	init();
 }
 
-// Ring index rebuild logic.
-// Called under ring_mutex.
-void engine::rebuild_ring_index()
+// Queue the ring for insertion.
+// Called by any thread, the engine thread picks it up on the next update.
+void engine::ring_index::push(ringbuf *ring)
 {
-	unsigned int i;
+	pending *p = new pending;
+	p->ring = ring;
+	do {
+		p->next = added;
+	} while (!__sync_bool_compare_and_swap(&added, p->next, p));
 
-	_stats.rings_indexed++;
+	dirty = true;
+}
+
+// Insert the ring after all the rings with the same or higher priority.
+// Called by the engine thread.
+void engine::ring_index::insert(ringbuf *ring)
+{
+	if (count == capacity) {
+		unsigned int ncap = capacity ? capacity * 2 : 16;
+		entry *ne = new entry [ncap];
+		for (unsigned int i = 0; i < count; i++)
+			ne[i] = entries[i];
+		delete [] entries;
+		entries  = ne;
+		capacity = ncap;
+	}
+
+	int prio = ring->prio();
+
+	// Binary search for the end of the priority bucket
+	unsigned int lo = 0, hi = count;
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		if (entries[mid].pit.const_ring()->prio() >= prio)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (unsigned int i = count; i > lo; i--)
+		entries[i] = entries[i - 1];
+
+	unsigned int slot = act.alloc();
+	if (slot == activity::NOSLOT)
+		noslot++;
+	else if (slot >= slot_pos.size())
+		slot_pos.resize(slot + 1, NOPOS);
+
+	entry &e = entries[lo];
+	e.pit     = ringbuf::pop_iterator(ring);
+	e.lastrec = 0;
+	e.seqnum  = 0;
+	e.slot    = slot;
+	e.budget  = ring->budget();
+	e.latency = (uint64_t) ring->max_latency_usec() * 1000;
+	count++;
+
+	if (e.latency && (!min_latency || e.latency < min_latency))
+		min_latency = e.latency;
+
+	// Update slot mapping for the shifted entries
+	for (unsigned int i = lo; i < count; i++) {
+		if (entries[i].slot != activity::NOSLOT)
+			slot_pos[entries[i].slot] = i;
+	}
 
-	ring_index oi = _ring_index;
-	ring_index ni;
+	if (slot != activity::NOSLOT) {
+		// Publish the slot to the writers.
+		// The ring might already have records, make sure it's visited.
+		ring->_activity_slot = slot;
+		barrier::memw();
+		ring->_activity = &act;
+		act.mark(slot);
+	}
+}
 
-	ni.count = _ring_map.size();
-	ni.dirty = false;
+// Invalidate the entry. It's compacted out on the next update,
+// the indices of the other entries do not change until then.
+void engine::ring_index::remove(unsigned int i)
+{
+	entry &e = entries[i];
+	e.pit.ring()->_activity = 0;
+	if (e.slot == activity::NOSLOT)
+		noslot--;
+	else {
+		slot_pos[e.slot] = NOPOS;
+		act.free(e.slot);
+	}
 
-	dprint("engine rebuilding ring index: ocount %d ncount %u", oi.count, ni.count);
+	entries[i].pit.invalidate();
+	entries[i].lastrec = 0;
+	dead++;
+	dirty = true;
+}
 
-	ni.entries = new ring_index::entry [ni.count];
+// Drop invalidated entries preserving the order of the rest
+void engine::ring_index::compact()
+{
+	unsigned int n = 0;
+	min_latency = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (!entries[i].pit.valid())
+			continue;
+		if (n != i) {
+			entries[n] = entries[i];
+			if (entries[n].slot != activity::NOSLOT)
+				slot_pos[entries[n].slot] = n;
+		}
+		uint64_t l = entries[n].latency;
+		if (l && (!min_latency || l < min_latency))
+			min_latency = l;
+		n++;
+	}
+	count = n;
+	dead  = 0;
+}
+
+// Collect the entries that need to be visited in this pass.
+// Active entries are sorted by index to preserve the priority order.
+void engine::ring_index::collect(bool all)
+{
+	unsigned int i, nwords = act.words();
 
-	// Populate index with ring pointers
-	ring_map::const_iterator it;
-	for (it = _ring_map.begin(), i = 0; it != _ring_map.end(); ++it, ++i) {
-		ringbuf *ring = it->second;
-		ni(i)->pit.ring(ring);
-		ni(i)->lastrec = 0;
-		ni(i)->seqnum    = 0;
+	active.clear();
+
+	if (all || full || noslot) {
+		full = false;
+		for (i = 0; i < nwords; i++)
+			act.take(i);
+		for (i = 0; i < count; i++) {
+			if (entries[i].pit.valid())
+				active.push_back(i);
+		}
+		return;
+	}
 
-		ring_index::entry *re = oi(ring);
-		if (re) {
-			ni(i)->seqnum = re->seqnum;
+	for (i = 0; i < nwords; i++) {
+		uint64_t bits = act.take(i);
+		while (bits) {
+			unsigned int slot = i * activity::WORD_BITS + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (slot < slot_pos.size() && slot_pos[slot] != NOPOS)
+				active.push_back(slot_pos[slot]);
 		}
 	}
 
-	// Sort it by priority
-	std::sort(ni.entries, ni.entries + ni.count, ring_sorter);
+	std::sort(active.begin(), active.end());
+}
 
-	// Dump new ring index
-	for (i=0; i < ni.count; i++) {
-		dprint("ring index #%u: name [%s] prio %u seqnum %llu",
-			i, ni(i)->pit.ring()->name(), ni(i)->pit.ring()->prio(), ni(i)->seqnum);
+// Re-arm the visited rings that still have records or are waiting
+// to be killed. Covers the records left behind by the TSO flush and
+// the writers that committed while the ring was being processed.
+void engine::ring_index::rearm()
+{
+	for (unsigned int k = 0; k < active.size(); k++) {
+		entry &e = entries[active[k]];
+		if (!e.pit.valid() || e.slot == activity::NOSLOT)
+			continue;
+		const ringbuf *r = e.pit.const_ring();
+		if (!r->empty() || r->orphan())
+			act.mark(e.slot);
 	}
+}
+
+// Apply pending ring index changes.
+// Entries keep their seqnums, only added and removed rings are touched.
+void engine::update_ring_index()
+{
+	_stats.rings_indexed++;
+
+	// Clear the flag before grabbing the pending list, the rings added
+	// after this point will trigger another update.
+	_ring_index.dirty = false;
+	barrier::memrw();
 
-	// Replace current index and delete the old one
-	_ring_index = ni;
-	delete [] oi.entries;
+	if (_ring_index.dead)
+		_ring_index.compact();
+
+	ring_index::pending *p = __sync_lock_test_and_set(&_ring_index.added, (ring_index::pending *) 0);
+
+	// Reverse the list to insert the rings in the order they were added
+	ring_index::pending *l = 0;
+	while (p) {
+		ring_index::pending *n = p->next;
+		p->next = l;
+		l = p;
+		p = n;
+	}
+
+	while (l) {
+		ring_index::pending *n = l->next;
+		if (l->ring->overwrites())
+			_ring_index.recorders.push_back(l->ring);
+		else
+			_ring_index.insert(l->ring);
+		dprint("ring index: added [%s] prio %u count %u",
+			l->ring->name(), l->ring->prio(), _ring_index.count);
+		delete l;
+		l = n;
+	}
 }
 
 // Switch to the new timesource.
@@ -250,44 +465,178 @@ void engine::switch_timesource(const ringbuf *ring, record *r)
 	inject_record(ring->name(), r->timestamp, r->seqnum, internal::INFO,
 			"switching timesource from %s to %s", _timesource->name(), ts->name());
 
-	pthread_mutex_lock(&_ring_mutex);
-
 	// FIXME: Ideally we need to at least try to flush the rings before switching
 	// the timesource to avoid confusing TSO but I don't have a good solution for
 	// that at this point.
 	_timesource = ts;
+	calibrate_timesource();
 
 	// Iterate all rings and update their timesource pointers.
-	ring_map::const_iterator it;
-	for (it = _ring_map.begin(); it != _ring_map.end(); ++it) {
-		ringbuf *ring = it->second;
-		ring->timesource(_timesource);
-	}
-
-	pthread_mutex_unlock(&_ring_mutex);
+	ring_map::reader rr(_ring_map);
+	for (unsigned int i = 0; i < rr->count; i++)
+		rr->items[i]->timesource(_timesource);
 }
 
 void engine::kill_orphan(unsigned int i, ringbuf *ring)
 {
+	// Hold on to the ring if it can be recycled
+	bool pool = _opts.ring_pool_size && !ring->immortal();
+	if (pool)
+		ring->hold();
+
 	// This is not critical. We don't want to stall the engine 
 	// thread just to cleanup an orphan.
-	if (!pthread_mutex_trylock(&_ring_mutex)) {
-		_ring_map.erase(ring->name());
+	// Ring map drops its reference once the lookups that could
+	// have seen the ring are done.
+	if (_ring_map.erase(ring, false)) {
+		// Remove from the index. The entry is compacted out
+		// next time we enter this loop.
+		_ring_index.remove(i);
+		if (pool)
+			_ring_index.retired.push_back(ring);
+	} else if (pool)
+		ring->release();
+}
 
-		// Invalidate index. It will be rebuilt next time we
-		// enter this loop.
-		_ring_index(i)->pit.invalidate();
-		_ring_index.dirty = true;
+// Free mask overlays replaced by the writers of the active rings.
+// Overlays still visible to the writers are left for the next pass.
+void engine::reclaim_overlays()
+{
+	for (unsigned int k = 0; k < _ring_index.active.size(); k++) {
+		ringbuf *ring = _ring_index(_ring_index.active[k])->pit.ring();
+		if (hogl_unlikely(ring->overlays_retired()))
+			ring->reclaim_overlays();
+	}
+}
 
-		pthread_mutex_unlock(&_ring_mutex);
+// Move retired rings into the pool.
+// A ring can be reused once the engine holds the only reference to it,
+// which means that the ring map has dropped it and nobody else can see it.
+// The oldest pooled ring is released to make room for the new one.
+void engine::recycle_rings()
+{
+	std::vector<ringbuf *> &retired = _ring_index.retired;
 
-		ring->release();
+	for (unsigned int i = 0; i < retired.size(); ) {
+		ringbuf *ring = retired[i];
+		if (ring->refcnt() != 1) {
+			i++;
+			continue;
+		}
+		retired.erase(retired.begin() + i);
+
+		// Let go of the recorder right away, it's not reused
+		if (ring->_recorder) {
+			ring->_recorder->release();
+			ring->_recorder = 0;
+		}
+
+		pool_put(ring);
+	}
+}
+
+// Put the ring (with one reference held) into the pool.
+// The oldest pooled ring is released if the pool is full.
+void engine::pool_put(ringbuf *ring)
+{
+	ringbuf *old = 0;
+	pthread_mutex_lock(&_pool_mutex);
+	if (_ring_pool.size() >= _opts.ring_pool_size) {
+		old = _ring_pool.front();
+		_ring_pool.erase(_ring_pool.begin());
+	}
+	_ring_pool.push_back(ring);
+	pthread_mutex_unlock(&_pool_mutex);
+
+	if (old)
+		old->release();
+}
+
+// Get a ring with the matching geometry from the pool.
+// @return recycled ring (with one reference held) or null if there isn't one
+ringbuf *engine::pool_get(const char *name, const ringbuf::options &opts)
+{
+	ringbuf *r = 0;
+
+	pthread_mutex_lock(&_pool_mutex);
+	for (unsigned int i = _ring_pool.size(); i > 0; i--) {
+		if (_ring_pool[i - 1]->fits(opts)) {
+			r = _ring_pool[i - 1];
+			_ring_pool.erase(_ring_pool.begin() + i - 1);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&_pool_mutex);
+
+	if (!r) {
+		__sync_fetch_and_add(&_stats.ring_pool_misses, 1);
+		return 0;
+	}
+
+	r->recycle(name, opts);
+	__sync_fetch_and_add(&_stats.ring_pool_hits, 1);
+	return r;
+}
+
+// Release all pooled rings
+void engine::pool_flush()
+{
+	std::vector<ringbuf *> pool;
+
+	pthread_mutex_lock(&_pool_mutex);
+	pool.swap(_ring_pool);
+	pthread_mutex_unlock(&_pool_mutex);
+
+	for (unsigned int i = 0; i < pool.size(); i++)
+		pool[i]->release();
+}
+
+// Allocate new ring within the memory limit.
+// Pooled rings are released first if the ring does not fit, then the capacity
+// is cut in half until it fits or gets down to the minimum.
+// @return new ring or null if it does not fit
+ringbuf *engine::alloc_ring(const char *name, const ringbuf::options &opts)
+{
+	ringbuf::options o = opts;
+	bool flushed = false;
+
+	while (1) {
+		ringbuf *r = new ringbuf(name, o, _ringmem);
+		if (r->allocated()) {
+			if (o.capacity != opts.capacity)
+				__sync_fetch_and_add(&_stats.rings_shrunk, 1);
+			update_memory_stats();
+			return r;
+		}
+		delete r;
+
+		if (!flushed && _opts.ring_pool_size) {
+			pool_flush();
+			flushed = true;
+			continue;
+		}
+
+		unsigned int cap = 1;
+		while (cap < o.capacity)
+			cap <<= 1;
+		if (cap <= MIN_RING_CAPACITY)
+			break;
+		o.capacity = cap / 2;
 	}
+
+	__sync_fetch_and_add(&_stats.rings_denied, 1);
+	return 0;
+}
+
+void engine::update_memory_stats()
+{
+	_stats.ring_memory      = _ringmem->reserved();
+	_stats.ring_memory_used = _ringmem->used();
 }
 
 void engine::flush_record(unsigned int i, record *r)
 {
-	const ringbuf *ring = _ring_index(i)->pit.ring();
+	ringbuf *ring = _ring_index(i)->pit.ring();
 
 	if (r->special()) {
 		// Process special record
@@ -301,13 +650,31 @@ void engine::flush_record(unsigned int i, record *r)
 			break;
 		};
 
-		r->ack();
+		// Writer is waiting for the ack
+		_acks.push_back(std::make_pair(ring, (uint64_t) r->seqnum));
 	} else {
-		// Feed regular record to the output
+		// Feed regular record to the output.
+		// Raw timestamps are converted here, after ordering, 
+		// to keep the conversion cost off the clients.
 		format::data d = {};
 		d.ring_name = ring->name();
+		d.ring_name_len = ring->name_len();
 		d.record    = r;
+		d.timestamp = _timesource->convert(r->timestamp);
 		_output.process(d);
+
+		// Output is done with the borrowed data at this point.
+		// It's either written out or copied into the output buffer.
+		if (hogl_unlikely(ring->borrows()))
+			r->release_borrowed();
+
+		// Errors and such fire flight recorder dumps
+		if (hogl_unlikely(!_ring_index.recorders.empty()) && !_dump_pending && 
+				_trigger->test(r->area, r->section)) {
+			_dump_pending = true;
+			_dump_area = r->area;
+			_dump_sect = r->section;
+		}
 	}
 
 	_stats.recs_out++;
@@ -321,7 +688,7 @@ void engine::inject_record(const char *ring_name, timestamp ts, uint64_t seqnum,
 	record fake;
 	fake.area    = internal_area();
 	fake.section = sect;
-	fake.timestamp = ts;
+	fake.timestamp = _timesource->convert(ts);
 	fake.seqnum    = seqnum;
 	fake.set_args(0, hogl::arg_gstr(fmt), arg0, arg1);
 
@@ -339,7 +706,7 @@ void engine::inject_record(const char *ring_name, timestamp ts, uint64_t seqnum,
 	record fake;
 	fake.area    = internal_area();
 	fake.section = sect;
-	fake.timestamp = ts;
+	fake.timestamp = _timesource->convert(ts);
 	fake.seqnum    = seqnum;
 	fake.set_args(0, hogl::arg_gstr(fmt), hogl::arg_gstr(arg0), hogl::arg_gstr(arg1));
 
@@ -349,6 +716,42 @@ void engine::inject_record(const char *ring_name, timestamp ts, uint64_t seqnum,
 	_output.process(d);
 }
 
+// Inject a fake record directly into the output (count + const char* args).
+// Warning: only static strings are allowed 
+void engine::inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
+		uint64_t arg0, const char *arg1, const char *arg2)
+{
+	record fake;
+	fake.area    = internal_area();
+	fake.section = sect;
+	fake.timestamp = _timesource->convert(ts);
+	fake.seqnum    = seqnum;
+	fake.set_args(0, hogl::arg_gstr(fmt), arg0, hogl::arg_gstr(arg1), hogl::arg_gstr(arg2));
+
+	format::data d = {};
+	d.ring_name = ring_name;
+	d.record    = &fake;
+	_output.process(d);
+}
+
+// Inject a fake record directly into the output (name + uint64_t args).
+// Warning: only static strings are allowed 
+void engine::inject_record(const char *ring_name, timestamp ts, uint64_t seqnum, unsigned int sect, const char *fmt, 
+		const char *arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3)
+{
+	record fake;
+	fake.area    = internal_area();
+	fake.section = sect;
+	fake.timestamp = _timesource->convert(ts);
+	fake.seqnum    = seqnum;
+	fake.set_args(0, hogl::arg_gstr(fmt), hogl::arg_gstr(arg0), arg1, arg2, arg3);
+
+	format::data d = {};
+	d.ring_name = ring_name;
+	d.record    = &fake;
+	_output.process(d);
+}
+
 void engine::do_flush_tso(unsigned int size)
 {
 	dprint("tso-flush: size %u (total %u)", size, _tso.size());
@@ -404,11 +807,12 @@ void engine::flush_full_tso()
 
 // Normal TSO flush.
 // Called at the end of the poll iteration.
-// Leaves 1/8 of the TSO buffer capacity to avoid flushing records out-of-order.
-void engine::flush_tso()
+// Leaves 1/8 of the TSO buffer capacity to avoid flushing records out-of-order,
+// unless asked to flush everything.
+void engine::flush_tso(bool all)
 {
 	unsigned int size = _tso.size();
-	unsigned int keep = _tso.capacity() / 8;
+	unsigned int keep = all ? 0 : _tso.capacity() / 8;
 
 	size = (size > keep) ? (size - keep) : 0;
 	if (size < _tso_leftover)
@@ -420,14 +824,36 @@ void engine::flush_tso()
 	_tso.reset();
 }
 
+// Get the number of records the ring is allowed to feed in this pass.
+// Rings that are late on their latency target are drained completely.
+// @param i ring index
+// @param r oldest record in the ring
+// @return record budget (0 - unlimited)
+unsigned int engine::ring_budget(unsigned int i, const record *r)
+{
+	const ring_index::entry *e = _ring_index(i);
+	if (!e->budget)
+		return 0;
+
+	if (e->latency) {
+		uint64_t now = _timesource->convert(_timesource->timestamp()).to_nsec();
+		if (now > _timesource->convert(r->timestamp).to_nsec() + e->latency)
+			return 0;
+	}
+
+	return e->budget;
+}
+
 // Process all rings with timestamp ordering
 void engine::process_rings_tso()
 {
 	// Iterate and process all rings.
 	// Records are pushed into the TSO buffer for sorting later.
 	// TSO buffer entries are tagged with the ring index number.
-	unsigned int i;
-	for (i = 0; i < _ring_index.count; i++) {
+	bool blocked = false;
+	unsigned int i, k;
+	for (k = 0; k < _ring_index.active.size(); k++) {
+		i = _ring_index.active[k];
 		ringbuf::pop_iterator &it = _ring_index(i)->pit;
 		if (hogl_unlikely(!it.valid()))
 			continue;
@@ -438,6 +864,12 @@ void engine::process_rings_tso()
 		dprint("engine processing: ring %p prio %u", (void*)it.ring(), it.ring()->prio());
 
 		hogl::timestamp tso_ts = 0;
+		unsigned int n = 0, budget = 0;
+
+		// Blocked writer can't post anything until we free some room.
+		// Flush everything we've got instead of holding records back for ordering.
+		if (hogl_unlikely(it.ring()->blocked()))
+			blocked = true;
 
 		it.reset();
 		while (1) {
@@ -445,6 +877,9 @@ void engine::process_rings_tso()
 			if (!te.rec)
 				break;
 
+			if (!n)
+				budget = ring_budget(i, te.rec);
+
 			// Make sure that timestamps from the same ring never go backwards.
 			// At this point we must flush records in order. So this is more of 
 			// hack for systems with broken timesources. It never kicks in if 
@@ -458,6 +893,13 @@ void engine::process_rings_tso()
 			_tso.push(te);
 			if (_tso.full())
 				flush_full_tso();
+
+			// Leave the rest for the next pass
+			if (hogl_unlikely(++n == budget)) {
+				_stats.rings_throttled++;
+				_backlog = true;
+				break;
+			}
 		}
 
 		// Check for orphans and kill them.
@@ -466,13 +908,14 @@ void engine::process_rings_tso()
 			kill_orphan(i, it.ring());
 	}
 
-	flush_tso();
+	flush_tso(blocked || _ring_index.act.ack_waiters());
 
 	// Read membarrier makes sure all reads from the rings are done
 	barrier::memr();
 
 	// Commit all changes
-	for (i = 0; i < _ring_index.count; i++) {
+	for (k = 0; k < _ring_index.active.size(); k++) {
+		i = _ring_index.active[k];
 		if (!_ring_index(i)->lastrec)
 			continue;
 
@@ -481,7 +924,8 @@ void engine::process_rings_tso()
 			continue;
 		it.rewind(_ring_index(i)->lastrec);
 		it.commit(ringbuf::NOBARRIER);
-		it.ring()->unblock();
+		if (it.ring()->unblock())
+			_stats.writers_woken++;
 		_ring_index(i)->lastrec = 0;
 	}
 }
@@ -489,9 +933,11 @@ void engine::process_rings_tso()
 // Process all rings without timestamp ordering
 void engine::process_rings_notso()
 {
-	// Iterate and process all rings
-	unsigned int i;
-	for (i = 0; i < _ring_index.count; i++) {
+	// Iterate and process active rings
+	unsigned int unblock = _opts.unblock_threshold;
+	unsigned int i, k;
+	for (k = 0; k < _ring_index.active.size(); k++) {
+		i = _ring_index.active[k];
 		ringbuf::pop_iterator &it = _ring_index(i)->pit;
 		if (hogl_unlikely(!it.valid()))
 			continue;
@@ -499,10 +945,31 @@ void engine::process_rings_notso()
 		dprint("engine processing: ring %p prio %u", (void*)it.ring(), it.ring()->prio());
 		it.reset();
 		record *r;
-		while ((r = it.next()))
+		unsigned int n = 0, budget = 0;
+		while ((r = it.next())) {
+			if (!n)
+				budget = ring_budget(i, r);
+
 			flush_record(i, r);
+			n++;
+
+			// Don't make blocked writer wait for the end of the pass
+			if (hogl_unlikely(unblock && !(n % unblock) && it.ring()->blocked())) {
+				it.commit();
+				if (it.ring()->unblock())
+					_stats.writers_woken++;
+			}
+
+			// Leave the rest for the next pass
+			if (hogl_unlikely(n == budget)) {
+				_stats.rings_throttled++;
+				_backlog = true;
+				break;
+			}
+		}
 		it.commit();
-		it.ring()->unblock();
+		if (it.ring()->unblock())
+			_stats.writers_woken++;
 
 		// Check for orphans and kill them.
 		// Only empty rings are killed.
@@ -516,25 +983,209 @@ void engine::process_rings()
 {
 	_stats.loops++;
 
-	// Check and rebuild the index if needed
-	if (hogl_unlikely(_ring_index.dirty)) {
-		// Index rebuild is not critical. We don't want
-		// to stall the engine thread just because something
-		// is hogging the lock.
-		if (!pthread_mutex_trylock(&_ring_mutex)) {
-			rebuild_ring_index();
-			pthread_mutex_unlock(&_ring_mutex);
-		}
-	}
+	// Check and update the index if needed
+	if (hogl_unlikely(_ring_index.dirty))
+		update_ring_index();
+
+	// Release orphans and old ring map snapshots
+	_ring_map.sync();
 
-	// Iterate and process all rings
+	if (hogl_unlikely(!_ring_index.retired.empty()))
+		recycle_rings();
+	update_memory_stats();
+
+	_backlog = false;
+
+	// Find out which rings have new records.
+	// Writers order their tail updates before testing the activity bits,
+	// so nothing is missed. Full pass once in a while is just a safety net.
+	_ring_index.collect(!(_stats.loops % ring_index::FULL_PASS_INTERVAL));
+	_stats.rings_visited += _ring_index.active.size();
+
+	reclaim_overlays();
+
+	// Iterate and process active rings
 	if (_opts.features & DISABLE_TSO)
 		process_rings_notso();
 	else
 		process_rings_tso();
 
+	_ring_index.rearm();
+
+	if (hogl_unlikely(_dump_requested || !_ring_index.recorders.empty()))
+		process_recorders();
+
+	report_suppressed();
+	calibrate_timesource();
+
 	// Flush output buffers
 	_output.flush();
+
+	// Ack special records now that everything before them is written out
+	if (hogl_unlikely(!_acks.empty())) {
+		for (unsigned int i = 0; i < _acks.size(); i++)
+			_acks[i].first->ack(_acks[i].second);
+		_acks.clear();
+		_ring_index.act.signal_acks();
+	}
+}
+
+// Process flight recorders.
+// Dumps recorded history if a trigger fired and releases orphaned recorders.
+void engine::process_recorders()
+{
+	if (_dump_requested || _dump_pending) {
+		_dump_requested = false;
+		do_dump_recorders();
+		_dump_pending = false;
+	}
+
+	for (unsigned int i = 0; i < _ring_index.recorders.size(); ) {
+		ringbuf *ring = _ring_index.recorders[i];
+		if (ring->orphan() && _ring_map.erase(ring, false)) {
+			_ring_index.recorders.erase(_ring_index.recorders.begin() + i);
+			continue;
+		}
+		i++;
+	}
+}
+
+// Dump flight recorders.
+// Takes a snapshot of every recorder and feeds the records into the output
+// in timestamp order. Recorders keep going while this is happening.
+void engine::do_dump_recorders()
+{
+	std::vector<ringbuf *> &recs = _ring_index.recorders;
+
+	// Size the buffer for all the snapshots
+	size_t size = 0;
+	for (unsigned int i = 0; i < recs.size(); i++) {
+		unsigned int n = recs[i]->capacity() - 1;
+		if (_opts.recorder_depth && n > _opts.recorder_depth)
+			n = _opts.recorder_depth;
+		size += (size_t) n * recs[i]->record_size();
+	}
+	if (_dump_buf.size() < size)
+		_dump_buf.resize(size);
+
+	// Raw timestamp goes into the dump mark, inject_record() converts it
+	timestamp now = _timesource->timestamp();
+	uint64_t nsec = _timesource->convert(now).to_nsec();
+	uint64_t oldest = 0, window = (uint64_t) _opts.recorder_window_usec * 1000;
+	if (window && nsec > window)
+		oldest = nsec - window;
+
+	std::vector<tsobuf::entry> ents;
+
+	uint8_t *buf = _dump_buf.data();
+	for (unsigned int i = 0; i < recs.size(); i++) {
+		unsigned int n = recs[i]->capacity() - 1;
+		if (_opts.recorder_depth && n > _opts.recorder_depth)
+			n = _opts.recorder_depth;
+
+		unsigned int rsize = recs[i]->record_size();
+		n = recs[i]->snapshot(buf, n);
+		for (unsigned int j = 0; j < n; j++) {
+			record *r = (record *) (buf + j * rsize);
+			r->timestamp = _timesource->convert(r->timestamp);
+			if (r->timestamp.to_nsec() < oldest)
+				continue;
+
+			tsobuf::entry te;
+			te.timestamp = r->timestamp;
+			te.rec = r;
+			te.tag = i;
+			ents.push_back(te);
+		}
+		buf += n * rsize;
+	}
+
+	std::stable_sort(ents.begin(), ents.end(),
+		[](const tsobuf::entry &a, const tsobuf::entry &b) { return a.timestamp < b.timestamp; });
+
+	_stats.recorder_dumps++;
+
+	if (_internal_area->test(internal::DUMPMARK)) {
+		if (_dump_pending)
+			inject_record("ENGINE", now, 0, internal::DUMPMARK,
+				"flight recorder dump: %llu record(s), triggered by %s:%s",
+				ents.size(), _dump_area->name(), _dump_area->section_name(_dump_sect));
+		else
+			inject_record("ENGINE", now, 0, internal::DUMPMARK,
+				"flight recorder dump: %llu record(s), requested", ents.size());
+	}
+
+	for (unsigned int k = 0; k < ents.size(); k++) {
+		const ringbuf *ring = recs[ents[k].tag];
+
+		format::data d = {};
+		d.ring_name = ring->name();
+		d.ring_name_len = ring->name_len();
+		d.record    = ents[k].rec;
+		_output.process(d);
+	}
+
+	_stats.recs_out += ents.size();
+}
+
+// Report records suppressed by the rate limits.
+// Summaries are generated at most once per second.
+void engine::report_suppressed()
+{
+	timestamp now = _timesource->timestamp();
+	uint64_t t = _timesource->convert(now).to_nsec(), last = _suppressed_ts.to_nsec();
+	if (t >= last && t - last < 1000000000)
+		return;
+
+	_suppressed_ts = t;
+
+	for (unsigned int i = 0; i < _ring_index.count; i++) {
+		ringbuf::pop_iterator &it = _ring_index(i)->pit;
+		if (hogl_unlikely(!it.valid()))
+			continue;
+
+		ringbuf *ring = it.ring();
+		limiter *l = ring->_limiter;
+		if (!l)
+			continue;
+		barrier::memr();
+
+		for (unsigned int j = 0; j < limiter::CAPACITY; j++) {
+			const area *a;
+			unsigned int s;
+			uint64_t n = l->take_suppressed(j, a, s);
+			if (!n)
+				continue;
+
+			if (_internal_area->test(internal::SUPPRESSMARK))
+				inject_record(ring->name(), now, 0, internal::SUPPRESSMARK,
+					"suppressed %llu record(s) in %s:%s", n, a->name(), a->section_name(s));
+
+			_stats.recs_suppressed += n;
+		}
+	}
+}
+
+// Recalibrate raw timesource.
+// Done at most once per second. Calibration parameters are logged
+// to make it possible to convert raw timestamps offline.
+void engine::calibrate_timesource()
+{
+	if (!_timesource->raw())
+		return;
+
+	// Timesource may be calibrated by another engine,
+	// log the parameters whenever they change.
+	_timesource->calibrate();
+	timesource::scale s = _timesource->get_scale();
+	if (s.base_raw == _calib_base)
+		return;
+	_calib_base = s.base_raw;
+
+	if (_internal_area->test(internal::CALIBMARK))
+		inject_record("ENGINE", s.base_raw, 0, internal::CALIBMARK,
+			"timesource %s base-raw %llu base-nsec %llu mult %llu",
+			_timesource->name(), s.base_raw, s.base_nsec, s.mult);
 }
 
 void engine::drain_rings()
@@ -542,6 +1193,7 @@ void engine::drain_rings()
 	dprint("draining all rings");
 
 	while (1) {
+		_ring_index.full = true;
 		process_rings();
 
 		// We can exit once we have no rings in the index
@@ -569,11 +1221,23 @@ void engine::loop()
 
 	start = gtod_usec();
 	while (!_killed) {
+		// Writers blocked on full rings wake us up
+		int seq = _ring_index.act.wake_seq();
+
 		process_rings();
 		ts = gtod_usec();
 		elapsed = ts - start;
-		if (elapsed < _opts.polling_interval_usec)
-			usleep(_opts.polling_interval_usec - elapsed);
+
+		// Poll often enough to meet the tightest latency target
+		uint64_t interval = _opts.polling_interval_usec;
+		uint64_t latency  = _ring_index.min_latency / 2000;
+		if (latency && latency < interval)
+			interval = latency;
+
+		// Rings that hit their budget get another pass right away.
+		// High priority rings are visited first in each pass.
+		if (!_backlog && elapsed < interval)
+			_ring_index.act.sleep(seq, interval - elapsed);
 		start = ts;
 	}
 
@@ -589,14 +1253,8 @@ void engine::loop()
  */
 const area *engine::find_area(const char *name) const
 {
-	area *a = 0;
-
-	pthread_mutex_lock(&_area_mutex);
-	area_map::const_iterator it = _area_map.find(name);
-	if (it != _area_map.end())
-		a = it->second;
-	pthread_mutex_unlock(&_area_mutex);
-	return a;
+	// Areas are never removed, no need to hold the reader
+	return _area_map.find(name);
 }
 
 /**
@@ -606,19 +1264,19 @@ const area *engine::find_area(const char *name) const
  */
 area *engine::add_area(const char *name, const char **sections)
 {
-	std::pair<area_map::iterator, bool> s;
-	area *a, *na = new area(name, sections);
+	area *a = 0, *na = new area(name, sections);
 
-	pthread_mutex_lock(&_area_mutex);
-	s = _area_map.insert(area_map::value_type(name, na));
-	a = s.first->second;
-	_stats.areas_added++;
-	pthread_mutex_unlock(&_area_mutex);
+	bool added = _area_map.insert(na, [&a](area *e) { a = e; });
+	__sync_fetch_and_add(&_stats.areas_added, 1);
+
+	if (added) {
+		a = na;
 
-	if (s.second != false) {
 		// New area.
 		// Apply current mask before returning the area to the caller.
+		pthread_mutex_lock(&_mask_mutex);
 		_mask.apply(a);
+		pthread_mutex_unlock(&_mask_mutex);
 
 		hogl::post(internal_area(), internal::AREA_DEBUG,
 			"new area %s(%p): number-of-sections %u", a->name(), a, a->count());
@@ -646,20 +1304,38 @@ area *engine::add_area(const char *name, const char **sections)
  */
 ringbuf *engine::add_ring(const char *name, const ringbuf::options &opts)
 {
-	std::pair<ring_map::iterator, bool> s;
-
-	ringbuf *nr = new ringbuf(name, opts);
-	nr->hold();
+	// Look for an existing ring first. There is no point in allocating
+	// (and possibly running into the memory limit) if it's reused.
+	ringbuf *r = find_ring(name);
+	if (r)
+		return reuse_ring(r);
+
+	// Reuse a drained ring if we've got one
+	ringbuf *nr = 0;
+	bool pooled = false;
+	if (_opts.ring_pool_size)
+		pooled = (nr = pool_get(name, opts)) != 0;
+	if (!nr) {
+		nr = alloc_ring(name, opts);
+		if (!nr) {
+			hogl::post(internal_area(), internal::WARN,
+				"failed to add ring %s. ring memory limit %lu reached.", name, _opts.ring_memory_limit);
+			return 0;
+		}
+		nr->hold();
+	}
 	nr->timesource(_timesource);
 
-	pthread_mutex_lock(&_ring_mutex);
-	s = _ring_map.insert(ring_map::value_type(name, nr));
-	s.first->second->hold();
-	pthread_mutex_unlock(&_ring_mutex);
+	nr->hold();
+	bool added = _ring_map.insert(nr, [&r](ringbuf *e) { r = e->hold(); });
 
-	if (s.second == true) {
-		// Ring added. Invalidate the index.
-		_ring_index.dirty = true;
+	if (added) {
+		// Ring added. Queue it for the index.
+		// Blocked writers can wake us up only once the ring is indexed,
+		// don't make them wait for the polling interval.
+		_ring_index.push(nr);
+		if (nr->blocking())
+			_ring_index.act.wake();
 
 		hogl::post(internal_area(), internal::RING_DEBUG,
 			"new ring %s(%p): prio %u capacity %u record-size %u",
@@ -668,12 +1344,24 @@ ringbuf *engine::add_ring(const char *name, const ringbuf::options &opts)
 		return nr;
 	}
 
-	// Ring already exists. Drop the one we allocated 
-	// and see if we can reuse the one we found.
+	// Lost the race with another add_ring(). Drop the one we allocated
+	// (pooled ring goes back to the pool, it was never used) and see if
+	// we can reuse the one we found.
 	nr->release();
+	if (pooled) {
+		pool_put(nr);
+		__sync_fetch_and_sub(&_stats.ring_pool_hits, 1);
+	} else
+		nr->release();
 
-	ringbuf *r = s.first->second;
+	return reuse_ring(r);
+}
 
+// Check if the existing ring can be reused by add_ring().
+// @param r existing ring (with a local reference held)
+// @return the ring or null if it cannot be reused (the reference is dropped)
+ringbuf *engine::reuse_ring(ringbuf *r)
+{
 	// Shared rings can be reused of course.
 	if (r->shared())
 		return r;
@@ -700,23 +1388,55 @@ ringbuf *engine::add_ring(const char *name, const ringbuf::options &opts)
  */
 bool engine::add_ring(ringbuf *r)
 {
-	std::pair<ring_map::iterator, bool> s;
-
-	pthread_mutex_lock(&_ring_mutex);
-	s = _ring_map.insert(ring_map::value_type(r->name(), r));
-	if (s.second == true) {
-		_ring_index.dirty = true;
-		r->hold();
-		r->timesource(_timesource);
+	r->hold();
+	r->timesource(_timesource);
+
+	bool added = _ring_map.insert(r);
+	if (added) {
+		_ring_index.push(r);
+		if (r->blocking())
+			_ring_index.act.wake();
+	} else {
+		r->release();
+		hogl::post(internal_area(), internal::ERROR,
+			"failed to add ring %s. already exists.", r->name());
 	}
-	pthread_mutex_unlock(&_ring_mutex);
 
-	if (!s.second) {
+	return added;
+}
+
+/**
+ * Attach flight recorder to the ring.
+ * This function must be called outside of the engine context. 
+ */
+bool engine::add_recorder(ringbuf *ring, const mask &m, const ringbuf::options &opts)
+{
+	if (ring->recorder()) {
 		hogl::post(internal_area(), internal::ERROR,
-			"failed to add ring %s. already exists.", r->name());
+			"failed to add recorder to ring %s. already has one.", ring->name());
+		return false;
 	}
 
-	return s.second;
+	// Recorder follows the sharing rules of its ring
+	ringbuf::options ropts = opts;
+	ropts.flags &= ~(ringbuf::SHARED | ringbuf::REUSABLE | ringbuf::BLOCKING | ringbuf::IMMORTAL);
+	ropts.flags |= ringbuf::RECORDER;
+	if (ring->shared())
+		ropts.flags |= ringbuf::SHARED;
+	if (ring->reusable())
+		ropts.flags |= ringbuf::REUSABLE;
+
+	std::string name(ring->name());
+	name += ".REC";
+
+	ringbuf *r = add_ring(name.c_str(), ropts);
+	if (!r)
+		return false;
+
+	r->set_overlay(m);
+	bool ok = ring->recorder(r);
+	r->release();
+	return ok;
 }
 
 /**
@@ -724,15 +1444,10 @@ bool engine::add_ring(ringbuf *r)
  */
 ringbuf *engine::find_ring(const char *name) const
 {
-	ringbuf *r = 0;
-
-	pthread_mutex_lock(&_ring_mutex);
-	ring_map::const_iterator it = _ring_map.find(name);
-	if (it != _ring_map.end()) {
-		r = it->second;
+	ring_map::reader rr(_ring_map);
+	ringbuf *r = rr.find(name);
+	if (r)
 		r = r->hold();
-	}
-	pthread_mutex_unlock(&_ring_mutex);
 	return r;
 }
 
@@ -741,27 +1456,28 @@ ringbuf *engine::find_ring(const char *name) const
  */
 void engine::list_rings(string_list &l) const
 {
-	pthread_mutex_lock(&_ring_mutex);
+	ring_map::reader rr(_ring_map);
 
-	ring_map::const_iterator it;
-	for (it = _ring_map.begin(); it != _ring_map.end(); ++it)
-		l.push_back(it->second->name());
+	string_list names;
+	for (unsigned int i = 0; i < rr->count; i++)
+		names.push_back(rr->items[i]->name());
+	names.sort();
 
-	pthread_mutex_unlock(&_ring_mutex);
+	l.splice(l.end(), names);
 }
 
 void engine::apply_mask(const mask &m)
 {
-	pthread_mutex_lock(&_area_mutex);
+	pthread_mutex_lock(&_mask_mutex);
 
 	_mask = m;
 
-	area_map::const_iterator it;
-	for (it = _area_map.begin(); it != _area_map.end(); ++it)
-		m.apply(it->second);
+	area_map::reader ar(_area_map);
+	for (unsigned int i = 0; i < ar->count; i++)
+		m.apply(ar->items[i]);
 
 	_stats.mask_changed++;
-	pthread_mutex_unlock(&_area_mutex);
+	pthread_mutex_unlock(&_mask_mutex);
 }
 
 /**
@@ -769,13 +1485,14 @@ void engine::apply_mask(const mask &m)
  */
 void engine::list_areas(string_list &l) const
 {
-	pthread_mutex_lock(&_area_mutex);
+	area_map::reader ar(_area_map);
 
-	area_map::const_iterator it;
-	for (it = _area_map.begin(); it != _area_map.end(); ++it)
-		l.push_back(it->second->name());
+	string_list names;
+	for (unsigned int i = 0; i < ar->count; i++)
+		names.push_back(ar->items[i]->name());
+	names.sort();
 
-	pthread_mutex_unlock(&_area_mutex);
+	l.splice(l.end(), names);
 }
 
 std::ostream& operator<< (std::ostream& s, const engine::stats& stats)
@@ -784,11 +1501,22 @@ std::ostream& operator<< (std::ostream& s, const engine::stats& stats)
 		<< "tso_full:"           << stats.tso_full           << ", "
 		<< "recs_out:"           << stats.recs_out           << ", "
 		<< "recs_dropped:"       << stats.recs_dropped       << ", "
+		<< "recs_suppressed:"    << stats.recs_suppressed    << ", "
 		<< "loops:"              << stats.loops              << ", "
 		<< "rings_indexed:"      << stats.rings_indexed      << ", "
+		<< "rings_visited:"      << stats.rings_visited      << ", "
+		<< "rings_throttled:"    << stats.rings_throttled    << ", "
+		<< "writers_woken:"      << stats.writers_woken      << ", "
 		<< "areas_added:"        << stats.areas_added        << ", "
 		<< "mask_changed:"       << stats.mask_changed       << ", "
 		<< "timesource_changed:" << stats.timesource_changed << ", "
+		<< "recorder_dumps:"     << stats.recorder_dumps     << ", "
+		<< "ring_pool_hits:"     << stats.ring_pool_hits     << ", "
+		<< "ring_pool_misses:"   << stats.ring_pool_misses   << ", "
+		<< "ring_memory:"        << stats.ring_memory        << ", "
+		<< "ring_memory_used:"   << stats.ring_memory_used   << ", "
+		<< "rings_shrunk:"       << stats.rings_shrunk       << ", "
+		<< "rings_denied:"       << stats.rings_denied       << ", "
 		<< " }"	<< std::endl;
 	return s;
 }
@@ -807,7 +1535,12 @@ std::ostream& operator<< (std::ostream& s, const engine::options& opts)
 		<< "tso_buffer_capacity:"   << opts.tso_buffer_capacity << ", "
 		<< "features:" << std::hex  << opts.features << ", "
 		<< "schedparam:"            << opts.schedparam << ", "
-		<< "timesource:"            << ts_name
+		<< "timesource:"            << ts_name << ", "
+		<< "unblock_threshold:"     << opts.unblock_threshold << ", "
+		<< "recorder_depth:"        << opts.recorder_depth << ", "
+		<< "recorder_window_usec:"  << opts.recorder_window_usec << ", "
+		<< "ring_pool_size:"        << opts.ring_pool_size << ", "
+		<< "ring_memory_limit:"     << opts.ring_memory_limit
 		<< " }"	<< std::endl;
 
 	s.flags(fmt);
@@ -32,6 +32,7 @@
 #include "hogl/tls.hpp"
 
 #include <unistd.h>
+#include <time.h>
 
 /**
  * @file flush.cc 
@@ -50,6 +51,53 @@ bool timeout(uint64_t &to, uint64_t usec)
 	return false;
 }
 
+static uint64_t monotonic_usec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Wait for the special record to get acked.
+// Kicks the engine and sleeps until it acks the records processed in 
+// the current pass. Falls back to polling if the ring is not attached 
+// to an engine yet.
+bool wait_ack(ringbuf *ring, uint64_t seq, uint64_t &to, uint64_t to_usec)
+{
+	activity *a = ring->engine_activity();
+	if (!a) {
+		while (!ring->acked(seq)) {
+			if (timeout(to, to_usec))
+				return false;
+		}
+		return true;
+	}
+
+	// Engine flushes everything it has got while we're waiting
+	a->ack_waiter(1);
+	a->wake();
+
+	bool acked = false;
+	uint64_t start = monotonic_usec() - to;
+	while (1) {
+		int aseq = a->ack_seq();
+		barrier::memr();
+		if (ring->acked(seq)) {
+			acked = true;
+			break;
+		}
+
+		to = monotonic_usec() - start;
+		if (to >= to_usec)
+			break;
+
+		a->wait_ack(aseq, to_usec - to);
+	}
+
+	a->ack_waiter(-1);
+	return acked;
+}
+
 // Note: This implementation is not self contained. 
 // It assumes that the engine (or something else) that is poping 
 // records out of this ring will ack the flush record.
@@ -72,12 +120,7 @@ static bool do_flush(ringbuf *ring, uint64_t to_usec)
 	ring->push_commit(r);
 
 	// Wait for it to get acked
-	while (!r->acked()) {
-		if (timeout(to, to_usec))
-			return false;
-	}
-
-	return true;
+	return wait_ack(ring, seq, to, to_usec);
 }
 
 bool flush(ringbuf *ring, unsigned int to_usec)
@@ -93,6 +136,16 @@ bool flush(ringbuf *ring, unsigned int to_usec)
 
 bool flush(unsigned int to_usec)
 {
+	// Threads that use per-CPU rings may have records in all of them
+	percpu *p = tls::cpu_rings();
+	if (p) {
+		for (unsigned int i = 0; i < p->count(); i++) {
+			if (!flush(p->ring(i), to_usec))
+				return false;
+		}
+		return true;
+	}
+
 	ringbuf *ring = tls::ring();
 	return flush(ring, to_usec);
 }
@@ -28,6 +28,11 @@
 #include <ctype.h>
 
 #include <sstream>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "hogl/detail/ntos.hpp"
 #include "hogl/area.hpp"
@@ -38,13 +43,16 @@ namespace hogl {
 
 format_basic::format_basic(uint32_t fields) :
 	_fields(fields), _last_timestamp(0)
-{ }
+{
+	_header = header_writer(_fields);
+}
 
 format_basic::format_basic(const char *fields) :
 	_fields(0), _last_timestamp(0)
 {
 	if (!fields) {
 		_fields = DEFAULT;
+		_header = header_writer(_fields);
 		return;
 	}
 
@@ -64,29 +72,315 @@ format_basic::format_basic(const char *fields) :
 		else if (s == "fast0")     _fields = FAST0;
 		else if (s == "fast1")     _fields = FAST1;
 	}
+
+	_header = header_writer(_fields);
+}
+
+// Staging buffer for xdump rendering.
+// Lines are composed here and handed over to the ostrbuf in large chunks
+// instead of one printf() per value.
+class xdump_buf {
+private:
+	enum { SIZE = 2048 };
+
+	ostrbuf&     _sb;
+	unsigned int _n;
+	uint8_t      _data[SIZE];
+
+public:
+	enum { CHUNK = 64 }; // Max number of input bytes processed in one step
+
+	// Get a pointer to at least len bytes of free space
+	uint8_t *reserve(unsigned int len)
+	{
+		if (_n + len > SIZE)
+			flush();
+		return _data + _n;
+	}
+
+	// Commit len bytes previously obtained with reserve()
+	void commit(unsigned int len) { _n += len; }
+
+	void push_back(uint8_t c)
+	{
+		*reserve(1) = c;
+		_n++;
+	}
+
+	void push_back(const char *str, unsigned int len)
+	{
+		memcpy(reserve(len), str, len);
+		_n += len;
+	}
+
+	void flush()
+	{
+		_sb.push_back(_data, _n);
+		_n = 0;
+	}
+
+	xdump_buf(ostrbuf &sb) : _sb(sb), _n(0) {}
+	~xdump_buf() { flush(); }
+};
+
+static const char xdump_hexmap[] = "0123456789abcdef";
+
+// Scalar versions of the byte converters.
+// Used on non-x86 platforms and for the tails that are not handled by the vector code.
+static void scalar_bytes_to_hex(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		dst[i * 2 + 0] = xdump_hexmap[src[i] >> 4];
+		dst[i * 2 + 1] = xdump_hexmap[src[i] & 0xf];
+	}
+}
+
+static void scalar_bytes_to_print(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	// Same as isprint() in the "C" locale
+	for (unsigned int i = 0; i < n; i++)
+		dst[i] = (uint8_t) (src[i] - 0x20) < 0x5f ? src[i] : '.';
+}
+
+#if defined(__SSE2__)
+
+// Convert nibbles (0-15) into lower case hex digits
+static inline __m128i sse2_nibble_to_hex(__m128i v)
+{
+	__m128i gt9 = _mm_cmpgt_epi8(v, _mm_set1_epi8(9));
+	v = _mm_add_epi8(v, _mm_set1_epi8('0'));
+	return _mm_add_epi8(v, _mm_and_si128(gt9, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static void sse2_bytes_to_hex(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	const __m128i m = _mm_set1_epi8(0xf);
+
+	unsigned int i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i v  = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i hi = sse2_nibble_to_hex(_mm_and_si128(_mm_srli_epi16(v, 4), m));
+		__m128i lo = sse2_nibble_to_hex(_mm_and_si128(v, m));
+		_mm_storeu_si128((__m128i *) (dst + i * 2 + 0),  _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *) (dst + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	scalar_bytes_to_hex(src + i, dst + i * 2, n - i);
+}
+
+static void sse2_bytes_to_print(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	unsigned int i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+		// Printable if (v - 0x20) <= 0x5e (unsigned)
+		__m128i t = _mm_sub_epi8(v, _mm_set1_epi8(0x20));
+		__m128i p = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(0x5e)), t);
+		v = _mm_or_si128(_mm_and_si128(p, v), _mm_andnot_si128(p, _mm_set1_epi8('.')));
+		_mm_storeu_si128((__m128i *) (dst + i), v);
+	}
+	scalar_bytes_to_print(src + i, dst + i, n - i);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HOGL_XDUMP_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_nibble_to_hex(__m256i v)
+{
+	__m256i gt9 = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(9));
+	v = _mm256_add_epi8(v, _mm256_set1_epi8('0'));
+	return _mm256_add_epi8(v, _mm256_and_si256(gt9, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+__attribute__((target("avx2")))
+static void avx2_bytes_to_hex(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	const __m256i m = _mm256_set1_epi8(0xf);
+
+	unsigned int i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i v  = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i hi = avx2_nibble_to_hex(_mm256_and_si256(_mm256_srli_epi16(v, 4), m));
+		__m256i lo = avx2_nibble_to_hex(_mm256_and_si256(v, m));
+
+		// Unpack works within 128-bit lanes. Swap the lanes to restore the byte order.
+		__m256i p0 = _mm256_unpacklo_epi8(hi, lo);
+		__m256i p1 = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *) (dst + i * 2 + 0),  _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256((__m256i *) (dst + i * 2 + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+	}
+	sse2_bytes_to_hex(src + i, dst + i * 2, n - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_bytes_to_print(const uint8_t *src, uint8_t *dst, unsigned int n)
+{
+	unsigned int i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(0x20));
+		__m256i p = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(0x5e)), t);
+		v = _mm256_blendv_epi8(_mm256_set1_epi8('.'), v, p);
+		_mm256_storeu_si256((__m256i *) (dst + i), v);
+	}
+	sse2_bytes_to_print(src + i, dst + i, n - i);
+}
+#endif // GNUC && x86
+
+#endif // SSE2
+
+// Byte converters.
+// Selected at startup based on the CPU features.
+typedef void (*xdump_converter)(const uint8_t *src, uint8_t *dst, unsigned int n);
+
+struct xdump_converters {
+	xdump_converter to_hex;   // n bytes -> 2*n hex digits
+	xdump_converter to_print; // n bytes -> n printable chars
+
+	xdump_converters()
+	{
+	#if defined(HOGL_XDUMP_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			to_hex   = avx2_bytes_to_hex;
+			to_print = avx2_bytes_to_print;
+			return;
+		}
+	#endif
+	#if defined(__SSE2__)
+		to_hex   = sse2_bytes_to_hex;
+		to_print = sse2_bytes_to_print;
+	#else
+		to_hex   = scalar_bytes_to_hex;
+		to_print = scalar_bytes_to_print;
+	#endif
+	}
+};
+
+static const xdump_converters& xdump_conv()
+{
+	static const xdump_converters conv;
+	return conv;
 }
 
+// Classic hexdump.
+// Equivalent to the following:
+//	sb.printf("\n\t%03d: ", offset);
+//	sb.printf("%02x ", data[offset + i]); (for each byte, padded with spaces)
+//	sb.push_back("  ");
+//	sb.push_back(isprint(b) ? b : '.'); (for each byte)
 static void do_hexdump(hogl::ostrbuf &sb, const uint8_t *data, uint32_t n, const hogl::arg_xdump::format& xf)
 {
+	const unsigned int chunk = xdump_buf::CHUNK;
+
+	// Zero line width means single line
+	unsigned int lw = xf.line_width ? xf.line_width : n;
+
+	const xdump_converters &conv = xdump_conv();
+	xdump_buf xb(sb);
+
+	uint8_t hex[chunk * 2];
+
 	unsigned int offset;
-	for (offset = 0; offset < n; offset += xf.line_width) {
-		sb.printf("\n\t%03d: ", offset);
-
-		unsigned int i;
-		for (i = 0; i < xf.line_width; i++) {
-			if ((i + offset) < n)
-				sb.printf("%02x ", data[offset + i]);
-			else
-				sb.push_back("   ");
+	for (offset = 0; offset < n; offset += lw) {
+		unsigned int nb = std::min(lw, n - offset);
+		unsigned int i, j;
+
+		uint8_t *str = xb.reserve(32);
+		i = 0;
+		str[i++] = '\n';
+		str[i++] = '\t';
+		u64tod(offset, str, i, 3);
+		str[i++] = ':';
+		str[i++] = ' ';
+		xb.commit(i);
+
+		// Hex columns
+		for (i = 0; i < nb; i += chunk) {
+			unsigned int cn = std::min(chunk, nb - i);
+			conv.to_hex(data + offset + i, hex, cn);
+
+			str = xb.reserve(cn * 3);
+			for (j = 0; j < cn; j++) {
+				str[j * 3 + 0] = hex[j * 2 + 0];
+				str[j * 3 + 1] = hex[j * 2 + 1];
+				str[j * 3 + 2] = ' ';
+			}
+			xb.commit(cn * 3);
 		}
-		sb.push_back("  ");
-		for (i = 0; i < xf.line_width && ((i + offset) < n); i++) {
-			uint8_t b = data[offset + i];
-			sb.push_back(isprint(b) ? b : '.');
+
+		// Pad partial line
+		for (i = nb; i < lw; i++)
+			xb.push_back("   ", 3);
+		xb.push_back("  ", 2);
+
+		// ASCII columns
+		for (i = 0; i < nb; i += chunk) {
+			unsigned int cn = std::min(chunk, nb - i);
+			conv.to_print(data + offset + i, xb.reserve(cn), cn);
+			xb.commit(cn);
 		}
 	}
 }
 
+// Hex dump of 8-bit values (no zero padding, same as "%x")
+static void xdump_hex(xdump_buf &xb, const uint8_t *data, uint32_t n, const hogl::arg_xdump::format& xf, bool delim)
+{
+	const unsigned int chunk = xdump_buf::CHUNK;
+	const xdump_converters &conv = xdump_conv();
+	uint8_t hex[chunk * 2];
+
+	for (unsigned int i = 0; i < n; i += chunk) {
+		unsigned int cn = std::min(chunk, n - i);
+		conv.to_hex(data + i, hex, cn);
+
+		uint8_t *str = xb.reserve(cn * 3);
+		unsigned int k = 0;
+		for (unsigned int j = 0; j < cn; j++) {
+			if (delim || j)
+				str[k++] = xf.delim;
+			if (hex[j * 2] != '0')
+				str[k++] = hex[j * 2];
+			str[k++] = hex[j * 2 + 1];
+		}
+		xb.commit(k);
+		delim = true;
+	}
+}
+
+// Hex dump of 16/32/64-bit values (no zero padding, same as "%x")
+template <typename T>
+static void xdump_hex(xdump_buf &xb, const T* data, uint32_t n, const hogl::arg_xdump::format& xf, bool delim)
+{
+	struct safe_ptr { T v; } hogl_packed;
+	const safe_ptr* ptr = (const safe_ptr*) data;
+
+	for (unsigned int i = 0; i < n; i++) {
+		uint8_t *str = xb.reserve(1 + sizeof(T) * 2);
+		unsigned int k = 0;
+		if (delim || i)
+			str[k++] = xf.delim;
+		u64tox(ptr[i].v, str, k);
+		xb.commit(k);
+	}
+}
+
+template <typename T>
+static void xdump_hex_multi(hogl::ostrbuf &sb, const T* data, uint32_t n, const hogl::arg_xdump::format& xf)
+{
+	if (!n) return;
+
+	xdump_buf xb(sb);
+
+	if (!xf.line_width)
+		return xdump_hex(xb, data, n, xf, false);
+
+	for (unsigned int i = 0; i < n; i += xf.line_width) {
+		xb.push_back("\n\t", 2);
+		xdump_hex(xb, data + i, std::min((unsigned int) xf.line_width, n - i), xf, false);
+	}
+}
+
 template <typename T>
 static void xdump_single(hogl::ostrbuf &sb, const T* data, uint32_t n, const char *fmt, const hogl::arg_xdump::format& xf)
 {
@@ -158,10 +452,10 @@ static void do_xdump(hogl::ostrbuf &sb, const uint8_t *data, uint32_t len)
 
 	case 'x':
 		switch (xf.byte_width) {
-		case 1: return xdump_multi(sb, (uint8_t*)  ptr, len, "%x",   xf);
-		case 2: return xdump_multi(sb, (uint16_t*) ptr, len, "%x",   xf);
-		case 4: return xdump_multi(sb, (uint32_t*) ptr, len, "%lx",  xf);
-		case 8: return xdump_multi(sb, (uint64_t*) ptr, len, "%llx", xf); }
+		case 1: return xdump_hex_multi(sb, (uint8_t*)  ptr, len, xf);
+		case 2: return xdump_hex_multi(sb, (uint16_t*) ptr, len, xf);
+		case 4: return xdump_hex_multi(sb, (uint32_t*) ptr, len, xf);
+		case 8: return xdump_hex_multi(sb, (uint64_t*) ptr, len, xf); }
 		break;
 
 	case 'd':
@@ -353,152 +647,181 @@ void format_basic::tscache::update(hogl::timestamp t)
 	u64tod(nlo, _str, i, NSEC_LO_LEN);
 }
 
-// Default header with date/time
-void format_basic::default_header(ostrbuf& sb, record_data& d)
+void format_basic::dtcache::update_datetime(time_t sec)
 {
-	const hogl::record &r = *d.record;
+	// Pick up timezone changes (TZ, /etc/localtime, DST rules).
+	// This runs at most once per second of log time.
+	tzset();
 
 	struct tm tm;
-	struct timespec ts;
-	r.timestamp.to_timespec(ts);
-        localtime_r(&ts.tv_sec, &tm);
+	localtime_r(&sec, &tm);
 
-	sb.printf("%02u%02u%04u %02u:%02u:%02u.%09u %s:%lu %s:%s ",
-			(tm.tm_mon + 1), tm.tm_mday, (1900 + tm.tm_year),
-			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec,
-			d.ring_name, r.seqnum, d.area_name, d.sect_name);
+	unsigned int i = 0;
+	u64tod(tm.tm_mon + 1, _str, i, 2);
+	u64tod(tm.tm_mday, _str, i, 2);
+	u64tod(1900 + tm.tm_year, _str, i, 4);
+	_str[i++] = ' ';
+	u64tod(tm.tm_hour, _str, i, 2);
+	_str[i++] = ':';
+	u64tod(tm.tm_min, _str, i, 2);
+	_str[i++] = ':';
+	u64tod(tm.tm_sec, _str, i, 2);
 }
 
-// Super fast header formatter
-void format_basic::fast0_header(ostrbuf& sb, record_data& d)
+void format_basic::dtcache::update(hogl::timestamp t)
 {
-	const hogl::record &r = *d.record;
-
-	// The following sequence is equvalent to 
-	//	sb.printf("%lu.%09u %s:%lu %s:%s ", ts.tv_sec, ts.tv_nsec,
-	//			d.ring_name, r.seqnum, d.area_name, d.sect_name);
-
-	unsigned int len_area_name = strlen(d.area_name);
-	unsigned int len_sect_name = strlen(d.sect_name);
-	unsigned int len_ring_name = strlen(d.ring_name);
+	struct timespec ts; t.to_timespec(ts);
 
-	// Compute total header len
-	unsigned int hlen = len_area_name + len_sect_name + len_ring_name + 6 + 3 * 20;
+	uint32_t nhi = ts.tv_nsec / NSEC_SPLIT;
+	uint32_t nlo = ts.tv_nsec % NSEC_SPLIT;
+	unsigned int i;
 
-	uint8_t str[hlen];
-	unsigned int i = 0;
+	if (_sec != ts.tv_sec) {
+		_sec = ts.tv_sec;
+		update_datetime(_sec);
+	}
 
-	_tscache.update(r.timestamp);
-	memcpy(&str[i], _tscache.str(), _tscache.len()); i += _tscache.len();
-	str[i++] = ' ';
-	memcpy(&str[i], d.ring_name, len_ring_name); i += len_ring_name;
-	str[i++] = ':';
-	u64tod(r.seqnum, str, i);
-	str[i++] = ' ';
-	memcpy(&str[i], d.area_name, len_area_name); i += len_area_name;
-	str[i++] = ':';
-	memcpy(&str[i], d.sect_name, len_sect_name); i += len_sect_name;
-	str[i++] = ' ';
+	i = NSEC_HI_OFFSET;
+	if (_nsec_hi != nhi) {
+		_nsec_hi = nhi;
+		u64tod(nhi, _str, i, NSEC_HI_LEN);
+	}
 
-	sb.push_back(str, i);
+	i = NSEC_LO_OFFSET;
+	u64tod(nlo, _str, i, NSEC_LO_LEN);
 }
 
-// Same as above plus timedelta
-void format_basic::fast1_header(ostrbuf& sb, record_data& d)
+// Generic header formatter.
+// F is a compile-time constant, all field checks are resolved by the compiler
+// and each instance boils down to a straight sequence of memcpy()s and u64tod()s.
+// Output is equivalent to
+//	sb.printf("%s %s (%llu) %s:%lu %s:%s ", timespec, timestamp, delta.to_nsec(),
+//		d.ring_name, r.seqnum, d.area_name, d.sect_name);
+// with the fields that are not enabled (and their separators) omitted.
+template<uint32_t F>
+void format_basic::header(ostrbuf& sb, record_data& d)
 {
 	const hogl::record &r = *d.record;
 
-	timestamp delta = r.timestamp - _last_timestamp;
-	if (hogl_unlikely(_last_timestamp == timestamp(0)))
-		delta = 0;
-
-	_last_timestamp = r.timestamp;
+	unsigned int len_ring_name = (F & RING)    ? d.ring_name_len : 0;
+	unsigned int len_area_name = (F & AREA)    ? d.area_name_len : 0;
+	unsigned int len_sect_name = (F & SECTION) ? d.sect_name_len : 0;
 
-	// The following sequence is equvalent to:
-	// 	sb.printf("%lu.%09u (%llu) %s:%lu %s:%s ", ts.tv_sec, ts.tv_nsec, delta.to_nsec(),
-	//		d.ring_name, r.seqnum, d.area_name, d.sect_name);
-	unsigned int len_area_name = strlen(d.area_name);
-	unsigned int len_sect_name = strlen(d.sect_name);
-	unsigned int len_ring_name = strlen(d.ring_name);
+	// Max len of the fixed size parts (including separators)
+	enum {
+		FIXED_LEN = ((F & TIMESPEC)  ? tscache::TS_LEN + 1 : 0) +
+			    ((F & TIMESTAMP) ? dtcache::TS_LEN + 1 : 0) +
+			    ((F & TIMEDELTA) ? 20 + 3 : 0) +
+			    ((F & SEQNUM)    ? 20 + 1 : 0) + 4
+	};
 
-	// Compute total header len	
-	unsigned int hlen = len_area_name + len_sect_name + len_ring_name + 9 + 4 * 20;
+	// Compute total header len
+	unsigned int hlen = FIXED_LEN + len_ring_name + len_area_name + len_sect_name;
 
 	uint8_t str[hlen];
 	unsigned int i = 0;
 
-	_tscache.update(r.timestamp);
-	memcpy(&str[i], _tscache.str(), _tscache.len()); i += _tscache.len();
-	str[i++] = ' ';
-	str[i++] = '(';
-	u64tod(delta, str, i);
-	str[i++] = ')';
-	str[i++] = ' ';
-	memcpy(&str[i], d.ring_name, len_ring_name); i += len_ring_name;
-	str[i++] = ':';
-	u64tod(r.seqnum, str, i);
-	str[i++] = ' ';
-	memcpy(&str[i], d.area_name, len_area_name); i += len_area_name;
-	str[i++] = ':';
-	memcpy(&str[i], d.sect_name, len_sect_name); i += len_sect_name;
-	str[i++] = ' ';
-
-	sb.push_back(str, i);
-}
-
-void format_basic::flexi_header(ostrbuf& sb, record_data& d)
-{
-	const hogl::record &r = *d.record;
-
-	if (_fields & TIMESPEC) {
-		_tscache.update(r.timestamp);
-		sb.push_back(_tscache.str(), _tscache.len());
-		sb.push_back(' ');
+	if (F & TIMESPEC) {
+		_tscache.update(d.timestamp);
+		memcpy(&str[i], _tscache.str(), _tscache.len()); i += _tscache.len();
+		str[i++] = ' ';
 	}
 
-	if (_fields & TIMESTAMP) {
-		struct tm tm;
-		struct timespec ts;
-		r.timestamp.to_timespec(ts);
-
-        	localtime_r(&ts.tv_sec, &tm);
-
-		sb.printf("%02u%02u%04u %02u:%02u:%02u.%09u ",
-			(tm.tm_mon + 1), tm.tm_mday, (1900 + tm.tm_year),
-			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
+	if (F & TIMESTAMP) {
+		_dtcache.update(d.timestamp);
+		memcpy(&str[i], _dtcache.str(), _dtcache.len()); i += _dtcache.len();
+		str[i++] = ' ';
 	}
 
-	if (_fields & TIMEDELTA) {
-		timestamp delta = r.timestamp - _last_timestamp;
+	if (F & TIMEDELTA) {
+		timestamp delta = d.timestamp - _last_timestamp;
 		if (hogl_unlikely(_last_timestamp == timestamp(0)))
 			delta = 0;
-		sb.printf("(%llu) ", delta.to_nsec());
-		_last_timestamp = r.timestamp;
+		_last_timestamp = d.timestamp;
+
+		str[i++] = '(';
+		u64tod(delta.to_nsec(), str, i);
+		str[i++] = ')';
+		str[i++] = ' ';
 	}
 
-	switch(_fields & (RING | SEQNUM)) {
-	case (RING | SEQNUM):
-		sb.printf("%s:%lu ", d.ring_name, r.seqnum);
-		break;
-	case RING:
-		sb.printf("%s ", d.ring_name);
-		break;
-	case SEQNUM:
-		sb.printf("%lu ", r.seqnum);
-		break;
+	if (F & RING) {
+		memcpy(&str[i], d.ring_name, len_ring_name); i += len_ring_name;
+		str[i++] = (F & SEQNUM) ? ':' : ' ';
 	}
 
-	switch(_fields & (AREA | SECTION)) {
-	case (AREA | SECTION):
-		sb.printf("%s:%s ", d.area_name, d.sect_name);
-		break;
-	case AREA:
-		sb.printf("%s ", d.area_name);
-		break;
-	case SECTION:
-		sb.printf("%s ", d.sect_name);
-		break;
+	if (F & SEQNUM) {
+		u64tod(r.seqnum, str, i);
+		str[i++] = ' ';
 	}
+
+	if ((F & AREA) && (F & SECTION)) {
+		if (hogl_likely(d.area_sect)) {
+			memcpy(&str[i], d.area_sect, d.area_sect_len); i += d.area_sect_len;
+		} else {
+			memcpy(&str[i], d.area_name, len_area_name); i += len_area_name;
+			str[i++] = ':';
+			memcpy(&str[i], d.sect_name, len_sect_name); i += len_sect_name;
+			str[i++] = ' ';
+		}
+	} else if (F & AREA) {
+		memcpy(&str[i], d.area_name, len_area_name); i += len_area_name;
+		str[i++] = ' ';
+	} else if (F & SECTION) {
+		memcpy(&str[i], d.sect_name, len_sect_name); i += len_sect_name;
+		str[i++] = ' ';
+	}
+
+	if (i)
+		sb.push_back(str, i);
+}
+
+template<>
+void format_basic::fill_header_table<0>(header_fn *t)
+{
+	t[0] = &format_basic::header<0>;
+}
+
+template<uint32_t F>
+void format_basic::fill_header_table(header_fn *t)
+{
+	t[F] = &format_basic::header<F>;
+	fill_header_table<F - 1>(t);
+}
+
+// Get header writer for the specified set of fields
+format_basic::header_fn format_basic::header_writer(uint32_t fields)
+{
+	struct table {
+		header_fn fn[FIELDS_MASK + 1];
+		table() { fill_header_table<FIELDS_MASK>(fn); }
+	};
+	static const table t;
+	return t.fn[fields & FIELDS_MASK];
+}
+
+// Default header with date/time
+void format_basic::default_header(ostrbuf& sb, record_data& d)
+{
+	header<DEFAULT>(sb, d);
+}
+
+// Super fast header formatter
+void format_basic::fast0_header(ostrbuf& sb, record_data& d)
+{
+	header<FAST0>(sb, d);
+}
+
+// Same as above plus timedelta
+void format_basic::fast1_header(ostrbuf& sb, record_data& d)
+{
+	header<FAST1>(sb, d);
+}
+
+// Header formatter for the current set of fields
+void format_basic::flexi_header(ostrbuf& sb, record_data& d)
+{
+	(this->*header_writer(_fields))(sb, d);
 }
 
 static const char* get_arg_str(const record& r, unsigned int type, unsigned int i)
@@ -525,17 +848,28 @@ void format_basic::process(ostrbuf &sb, const format::data &d)
 
 	record_data rd = {};
 	rd.record    = d.record;
+	rd.timestamp = d.nsec();
 	rd.ring_name = d.ring_name;
 	rd.next_arg  = 0;
 
-	// Preprocess names
+	// Preprocess names. Lengths are cached by the ring and area.
+	rd.ring_name_len = d.ring_name_len;
+	if (!rd.ring_name_len)
+		rd.ring_name_len = strlen(rd.ring_name);
+
 	const hogl::area *area = r.area;
-	if (area) {
+	if (area && (rd.area_sect = area->section_prefix(r.section, rd.area_sect_len))) {
 		rd.area_name = area->name();
 		rd.sect_name = area->section_name(r.section);
+		rd.area_name_len = area->name_len();
+		rd.sect_name_len = area->section_name_len(r.section);
 	} else {
-		rd.area_name = "INVALID";
+		rd.area_name = area ? area->name() : "INVALID";
 		rd.sect_name = "INVALID";
+		rd.area_name_len = strlen(rd.area_name);
+		rd.sect_name_len = strlen(rd.sect_name);
+		rd.area_sect = 0;
+		rd.area_sect_len = 0;
 	}
 
 	// Preprocess strings
@@ -547,14 +881,7 @@ void format_basic::process(ostrbuf &sb, const format::data &d)
 			rd.arg_str[i] = get_arg_str(r, type, i);
 	}
 
-	if (_fields == DEFAULT)
-		default_header(sb, rd);
-	else if (_fields == FAST0)
-		fast0_header(sb, rd);
-	else if (_fields == FAST1)
-		fast1_header(sb, rd);
-	else
-		flexi_header(sb, rd);
+	(this->*_header)(sb, rd);
 
 	unsigned int t0 = r.get_arg_type(0);
 	unsigned int t1 = r.get_arg_type(1);
@@ -36,6 +36,7 @@ namespace hogl {
 class raw_packer {
 private:
 	ostrbuf &_sb;
+	bool     _long_str;
 
 	template <typename T>
 	void add_uint(T v)
@@ -63,6 +64,19 @@ private:
 		add_str<T>(str, strlen(str));
 	}
 
+	void add_any_str(const char *str, unsigned long len)
+	{
+		if (_long_str)
+			add_str<uint32_t>(str, len);
+		else
+			add_str<uint16_t>(str, len);
+	}
+
+	void add_any_str(const char *str)
+	{
+		add_any_str(str, strlen(str));
+	}
+
 	void add_args(const record &r)
 	{
 		add_uint<uint64_t>(r.argtype);
@@ -81,16 +95,18 @@ private:
 				add_blob<uint32_t>(data, len);
 				break;
 
+			// Strings spilled into the arena can be longer than 64KB.
+			// Those are cut at 64KB unless long strings (RAW v1.2) are enabled.
 			case arg::CSTR:
 				data = r.get_arg_data(i, len);
-				add_str<uint16_t>((const char *) data, len);
+				add_any_str((const char *) data, len);
 				break;
 
 			case arg::GSTR:
 				if (arg::is_32bit(arg::GSTR))
-					add_str<uint16_t>((const char *) (unsigned long) r.get_arg_val32(i));
+					add_any_str((const char *) (unsigned long) r.get_arg_val32(i));
 				else
-					add_str<uint16_t>((const char *) r.get_arg_val64(i));
+					add_any_str((const char *) r.get_arg_val64(i));
 				break;
 			case arg::INT32:
 			case arg::UINT32:
@@ -104,7 +120,7 @@ private:
 	}
 
 public:
-	raw_packer(ostrbuf &sb) : _sb(sb) {}
+	raw_packer(ostrbuf &sb, bool long_str) : _sb(sb), _long_str(long_str) {}
 
 	void pack(const format::data &d)
 	{
@@ -120,7 +136,7 @@ public:
 			sect_name = area->section_name(r.section);
 		}
 
-		add_uint<uint64_t>(r.timestamp);
+		add_uint<uint64_t>(d.nsec());
 		add_uint<uint64_t>(r.seqnum);
 		add_str<uint8_t>(ring_name);
 		add_str<uint8_t>(area_name);
@@ -129,12 +145,13 @@ public:
 	}
 };
 
-format_raw::format_raw()
+format_raw::format_raw(unsigned int flags) :
+	_flags(flags)
 { }
 
 void format_raw::process(ostrbuf &sb, const format::data &d)
 {
-	raw_packer rp(sb);
+	raw_packer rp(sb, _flags & LONG_STRINGS);
 	rp.pack(d);
 }
 
@@ -0,0 +1,81 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "hogl/detail/futex.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+namespace futex {
+
+#if defined(__linux__)
+
+void wait(volatile int *addr, int val, unsigned int usec)
+{
+	struct timespec ts, *to = 0;
+	if (usec) {
+		ts.tv_sec  = usec / 1000000;
+		ts.tv_nsec = (usec % 1000000) * 1000;
+		to = &ts;
+	}
+	syscall(SYS_futex, (int *) addr, FUTEX_WAIT_PRIVATE, val, to, 0, 0);
+}
+
+void wake(volatile int *addr, int n)
+{
+	syscall(SYS_futex, (int *) addr, FUTEX_WAKE_PRIVATE, n, 0, 0, 0);
+}
+
+#else
+
+// No futexes. Waiters poll the word with short sleeps.
+void wait(volatile int *addr, int val, unsigned int usec)
+{
+	const unsigned int step = 100;
+	unsigned int slept = 0;
+	while (*addr == val && (!usec || slept < usec)) {
+		usleep(step);
+		slept += step;
+	}
+}
+
+void wake(volatile int *, int)
+{ }
+
+#endif
+
+} // namespace futex
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -42,6 +42,9 @@ const char *internal::section_names[] = {
 	"AREA:DEBUG",
 	"RING:DEBUG",
 	"TLS:DEBUG",
+	"SUPPRESSMARK",
+	"CALIBMARK",
+	"DUMPMARK",
 	0
 };
 
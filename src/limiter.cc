@@ -0,0 +1,129 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+
+#include "hogl/detail/limiter.hpp"
+#include "hogl/detail/barrier.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+static const uint64_t nsec_per_sec = 1000000000;
+
+limiter::limiter()
+{
+	memset(_entry, 0, sizeof(_entry));
+}
+
+// Find (or allocate) the entry for the area and section
+limiter::entry *limiter::find(const hogl::area *a, unsigned int s, hogl::timestamp now, const area::limit &l)
+{
+	unsigned int h = ((uintptr_t) a >> 4) ^ (s * 0x9e3779b1U);
+	h ^= h >> 16;
+
+	for (unsigned int n = 0; n < CAPACITY; n++) {
+		entry *e = &_entry[(h + n) & (CAPACITY - 1)];
+		if (hogl_likely(e->area == a && e->sect == s))
+			return e;
+		if (e->area)
+			continue;
+
+		// New entry. Starts with the full bucket.
+		e->sect   = s;
+		e->tokens = (uint64_t) l.rate * nsec_per_sec;
+		e->last   = now.to_nsec();
+		e->count  = 0;
+		e->suppressed = 0;
+
+		// Make sure the entry is complete before the engine sees it
+		barrier::memw();
+		e->area = a;
+		return e;
+	}
+
+	return 0;
+}
+
+bool limiter::admit(const hogl::area *a, unsigned int s, hogl::timestamp now)
+{
+	area::limit l = a->get_limit(s);
+	if (!l.active())
+		return true;
+
+	entry *e = find(a, s, now, l);
+	if (!e)
+		return true;
+
+	bool ok = true;
+
+	// Sampling
+	if (l.sample > 1)
+		ok = (e->count++ % l.sample) == 0;
+
+	// Token bucket. Holds up to one second worth of records, each
+	// record costs nsec_per_sec tokens, refilled at 'rate' tokens per nsec.
+	if (ok && l.rate) {
+		uint64_t t = now.to_nsec();
+		uint64_t elapsed = t > e->last ? t - e->last : 0;
+		if (elapsed > nsec_per_sec)
+			elapsed = nsec_per_sec;
+		e->last = t;
+
+		uint64_t cap = (uint64_t) l.rate * nsec_per_sec;
+		e->tokens += elapsed * l.rate;
+		if (e->tokens > cap)
+			e->tokens = cap;
+
+		if (e->tokens >= nsec_per_sec)
+			e->tokens -= nsec_per_sec;
+		else
+			ok = false;
+	}
+
+	if (!ok)
+		__sync_add_and_fetch(&e->suppressed, 1);
+
+	return ok;
+}
+
+uint64_t limiter::take_suppressed(unsigned int i, const hogl::area *&a, unsigned int &s)
+{
+	entry *e = &_entry[i];
+
+	a = e->area;
+	if (!a)
+		return 0;
+	barrier::memr();
+
+	s = e->sect;
+	if (!e->suppressed)
+		return 0;
+	return __sync_fetch_and_and(&e->suppressed, 0);
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
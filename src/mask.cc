@@ -25,6 +25,7 @@
 */
 
 #include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 
@@ -32,6 +33,10 @@
 #include <string>
 #include <sstream>
 #include <regex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
 
 #include "hogl/detail/mask.hpp"
 #include "hogl/detail/area.hpp"
@@ -46,67 +51,424 @@
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
 
+// Compiled name pattern.
+// Mask patterns are POSIX extended regexs but in practice most of them are
+// literals (DEBUG), prefixes (NET.*), suffixes (.*DEBUG) or literal alternations
+// ((INFO|WARN).*). Those are compiled into a list of segments and matched
+// directly. Everything else goes through std::regex.
+class pattern {
+private:
+	struct seg {
+		bool star;                     // matches any sequence of chars
+		std::vector<std::string> alts; // literal alternatives
+	};
+
+	std::vector<seg> _seg;
+	std::shared_ptr<std::regex> _re;
+
+	static bool is_meta(char c) { return strchr(".[]{}()*+?^$|\\", c) != 0; }
+
+	void push_star()
+	{
+		if (_seg.empty() || !_seg.back().star) {
+			seg sg; sg.star = true;
+			_seg.push_back(sg);
+		}
+	}
+
+	void push_alts(const std::vector<std::string> &alts)
+	{
+		seg sg; sg.star = false; sg.alts = alts;
+		_seg.push_back(sg);
+	}
+
+	void push_literal(std::string &lit)
+	{
+		if (lit.empty())
+			return;
+		push_alts(std::vector<std::string>(1, lit));
+		lit.clear();
+	}
+
+	// Parse literal string (with escaped meta chars)
+	static bool parse_literal(const std::string &s, std::string &lit)
+	{
+		for (size_t i = 0; i < s.size(); i++) {
+			char c = s[i];
+			if (c == '\\' && i + 1 < s.size() && is_meta(s[i + 1]))
+				c = s[++i];
+			else if (is_meta(c))
+				return false;
+			lit += c;
+		}
+		return true;
+	}
+
+	bool compile(const std::string &s)
+	{
+		size_t i = 0, n = s.size();
+		if (i < n && s[i] == '^')
+			i++;
+		if (n > i && s[n - 1] == '$' && (n < 2 || s[n - 2] != '\\'))
+			n--;
+
+		std::string lit;
+		while (i < n) {
+			char c = s[i];
+
+			if (c == '.' && i + 1 < n && s[i + 1] == '*') {
+				push_literal(lit);
+				push_star();
+				i += 2;
+				continue;
+			}
+
+			if (c == '(') {
+				size_t close = s.find(')', i);
+				if (close == s.npos || close >= n)
+					return false;
+				if (close + 1 < n && strchr("*+?{", s[close + 1]))
+					return false;
+
+				std::vector<std::string> alts;
+				std::stringstream ss(s.substr(i + 1, close - i - 1));
+				for (std::string a; std::getline(ss, a, '|'); ) {
+					std::string l;
+					if (!parse_literal(a, l))
+						return false;
+					alts.push_back(l);
+				}
+				if (alts.empty() || s[close - 1] == '|')
+					alts.push_back("");
+
+				push_literal(lit);
+				push_alts(alts);
+				i = close + 1;
+				continue;
+			}
+
+			if (c == '\\' && i + 1 < n && is_meta(s[i + 1]))
+				c = s[++i];
+			else if (is_meta(c))
+				return false;
+
+			// Quantified chars are not supported
+			if (i + 1 < n && strchr("*+?{", s[i + 1]))
+				return false;
+
+			lit += c;
+			i++;
+		}
+
+		push_literal(lit);
+		return true;
+	}
+
+	static bool match(const seg *s, const seg *end, const char *p, const char *e)
+	{
+		for (; s != end; ++s) {
+			if (s->star) {
+				if (s + 1 == end)
+					return true;
+				for (const char *q = p; q <= e; q++)
+					if (match(s + 1, end, q, e))
+						return true;
+				return false;
+			}
+
+			if (s->alts.size() == 1) {
+				const std::string &l = s->alts[0];
+				if ((size_t)(e - p) < l.size() || memcmp(p, l.data(), l.size()))
+					return false;
+				p += l.size();
+				continue;
+			}
+
+			for (size_t i = 0; i < s->alts.size(); i++) {
+				const std::string &l = s->alts[i];
+				if ((size_t)(e - p) >= l.size() && !memcmp(p, l.data(), l.size()) &&
+						match(s + 1, end, p + l.size(), e))
+					return true;
+			}
+			return false;
+		}
+		return p == e;
+	}
+
+public:
+	explicit pattern(const std::string &s)
+	{
+		if (!compile(s)) {
+			_seg.clear();
+			_re = std::make_shared<std::regex>(s, std::regex::extended | std::regex::optimize);
+		}
+	}
+
+	bool match(const char *str) const
+	{
+		if (_re)
+			return std::regex_match(str, *_re);
+		return match(_seg.data(), _seg.data() + _seg.size(), str, str + strlen(str));
+	}
+
+	bool is_regex() const { return (bool) _re; }
+};
+
 struct mask::data {
 	const std::string str;
-	const std::regex  area;
-	const std::regex  sect;
+	const pattern area;
+	const pattern sect;
 	bool  on;
+	bool  critical;
+	area::limit lim;
 
-	data(const std::string& _str, const std::regex& _area, const std::regex& _sect, bool _on) :
-		str(_str), area(_area), sect(_sect), on(_on) { }
+	data(const std::string& _str, const std::string& _area, const std::string& _sect, bool _on,
+			bool _critical, const area::limit &_lim) :
+		str(_str), area(_area), sect(_sect), on(_on), critical(_critical), lim(_lim) { }
+};
+
+// Cache of the match results.
+// Maps area and section names to the list of matching rules.
+// Section names are shared by most areas, so most lookups hit the cache.
+// The size is bounded, entries that were not used recently are evicted
+// one by one (clock).
+struct mask::cache {
+	enum { MAX_SIZE = 4096 };
+
+	typedef std::vector<bool> rule_set;
+
+	struct entry {
+		rule_set rules;
+		bool     used;
+	};
+
+	typedef std::unordered_map<std::string, entry> match_map;
+
+	struct table {
+		match_map map;
+		std::vector<match_map::value_type *> clock; // Entries in eviction order
+		size_t    hand;
+
+		table() : hand(0) { }
+
+		void clear()
+		{
+			map.clear();
+			clock.clear();
+			hand = 0;
+		}
+
+		// Evict entries until n more fit.
+		// Entries that were used since the last sweep get a second chance.
+		void make_room(size_t n)
+		{
+			while (!clock.empty() && clock.size() + n > MAX_SIZE) {
+				if (hand >= clock.size())
+					hand = 0;
+				match_map::value_type *v = clock[hand];
+				if (v->second.used) {
+					v->second.used = false;
+					hand++;
+					continue;
+				}
+				map.erase(map.find(v->first));
+				clock[hand] = clock.back();
+				clock.pop_back();
+			}
+		}
+	};
+
+	pthread_mutex_t mutex;
+	table area;
+	table sect;
+
+	cache()  { pthread_mutex_init(&mutex, NULL); }
+	~cache() { pthread_mutex_destroy(&mutex); }
+
+	void clear()
+	{
+		pthread_mutex_lock(&mutex);
+		area.clear();
+		sect.clear();
+		pthread_mutex_unlock(&mutex);
+	}
 };
 
 void mask::clear()
 {
 	_list->clear();
+	_cache->clear();
+}
+
+// Parse rate limit spec.
+// Comma separated list of
+//    N/s      - at most N records per second
+//    1/N      - post one in N records
+//    critical - records may use the room reserved in the rings
+// Invalid entries are ignored.
+static area::limit parse_limit(const std::string &str, bool &critical)
+{
+	area::limit l = { 0, 0 };
+
+	std::stringstream ss(str);
+	for (std::string s; std::getline(ss, s, ','); ) {
+		if (s == "critical") {
+			critical = true;
+			continue;
+		}
+
+		size_t d = s.find('/');
+		if (d == s.npos || d == 0)
+			continue;
+
+		char *end;
+		unsigned long n = strtoul(s.c_str(), &end, 10);
+		if (end != s.c_str() + d)
+			continue;
+
+		std::string per = s.substr(d + 1);
+		if (per == "s") {
+			l.rate = n;
+			continue;
+		}
+
+		unsigned long m = strtoul(per.c_str(), &end, 10);
+		if (n == 1 && *end == '\0' && !per.empty())
+			l.sample = m;
+	}
+
+	return l;
 }
 
 void mask::add(const std::string &str)
 {
 	bool on = (str[0] != '!');
 	size_t abeg = !on;
+	size_t lbeg = str.rfind('@');
 	size_t aend = str.find(':', abeg);
 	std::string areg, sreg;
-	if (aend == str.npos) {
+
+	area::limit lim = { 0, 0 };
+	bool critical = false;
+	if (lbeg != str.npos) {
+		if (on)
+			lim = parse_limit(str.substr(lbeg + 1), critical);
+	} else
+		lbeg = str.size();
+
+	if (aend == str.npos || aend > lbeg) {
 		areg = ".*";
-		sreg = str.substr(abeg);
+		sreg = str.substr(abeg, lbeg - abeg);
 	} else {
 		areg = str.substr(abeg, aend - abeg);
-		sreg = str.substr(aend + 1);
+		sreg = str.substr(aend + 1, lbeg - aend - 1);
 	}
 
 	if (areg.empty()) areg = ".*";
 	if (sreg.empty()) sreg = ".*";
 
-	_list->push_back(mask::data(str,
-				std::regex(areg, std::regex::extended | std::regex::optimize),
-				std::regex(sreg, std::regex::extended | std::regex::optimize),
-				on)
-			);
+	_list->push_back(mask::data(str, areg, sreg, on, critical, lim));
+	_cache->clear();
+}
+
+// Get the list of rules that match the name.
+// Called under cache mutex.
+template <typename F>
+static const mask::cache::rule_set& __match(mask::cache::table &t, const char *name, F get)
+{
+	mask::cache::match_map::iterator it = t.map.find(name);
+	if (it == t.map.end()) {
+		it = t.map.insert(std::make_pair(std::string(name), mask::cache::entry())).first;
+		t.clock.push_back(&*it);
+		get(name, it->second.rules);
+	}
+	it->second.used = true;
+	return it->second.rules;
 }
 
-static void __apply(area &area, const std::regex &re, bool on)
+// Find the last rule that matches each section of the area.
+// @return false if no rules match the area name
+bool mask::match(const area &area, std::vector<const data *> &rules) const
 {
-	unsigned int i;
-	for (i=0; i < area.size(); i++) {
-		const std::string str(area.section_name(i));
-		if (std::regex_match(str, re))
-			area.set(i, on);
+	if (_list->empty())
+		return false;
+
+	pthread_mutex_lock(&_cache->mutex);
+
+	// Cached results must stay valid until we're done.
+	// Make room for all the lookups up front.
+	_cache->area.make_room(1);
+	_cache->sect.make_room(area.size());
+
+	const data_list &list = *_list;
+
+	const cache::rule_set &am = __match(_cache->area, area.name(),
+		[&list](const char *name, cache::rule_set &rs) {
+			for (data_list::const_iterator it = list.begin(); it != list.end(); ++it)
+				rs.push_back(it->area.match(name));
+		});
+
+	if (std::find(am.begin(), am.end(), true) == am.end()) {
+		pthread_mutex_unlock(&_cache->mutex);
+		return false;
+	}
+
+	std::vector<const cache::rule_set *> sm(area.size());
+	for (unsigned int i=0; i < area.size(); i++)
+		sm[i] = &__match(_cache->sect, area.section_name(i),
+			[&list](const char *name, cache::rule_set &rs) {
+				for (data_list::const_iterator it = list.begin(); it != list.end(); ++it)
+					rs.push_back(it->sect.match(name));
+			});
+
+	// Rules are applied in order, the last match wins
+	rules.assign(area.size(), 0);
+	unsigned int r = 0;
+	for (data_list::const_iterator it = list.begin(); it != list.end(); ++it, ++r) {
+		if (!am[r])
+			continue;
+		for (unsigned int i=0; i < area.size(); i++) {
+			if ((*sm[i])[r])
+				rules[i] = &(*it);
+		}
 	}
+
+	pthread_mutex_unlock(&_cache->mutex);
+	return true;
 }
 
 void mask::apply(area &area) const
 {
-	data_list::const_iterator it;
-	for (it=_list->begin(); it != _list->end(); ++it) {
-		const std::string str(area.name());
-		if (std::regex_match(str, it->area)) {
-			dprint("applying mask %p to area %p [%s]", (void*)this, (void*)&area, area.name());
-			__apply(area, it->sect, it->on);
+	std::vector<const data *> rules;
+	if (!match(area, rules))
+		return;
+
+	dprint("applying mask %p to area %p [%s]", (void*)this, (void*)&area, area.name());
+
+	for (unsigned int i=0; i < area.size(); i++) {
+		if (rules[i]) {
+			area.set(i, rules[i]->on);
+			area.set_critical(i, rules[i]->critical);
+			area.set_limit(i, rules[i]->lim);
 		}
 	}
 }
 
+void mask::apply(const area &area, bitmap &b) const
+{
+	b.resize(area.size());
+	b.reset();
+
+	std::vector<const data *> rules;
+	if (!match(area, rules))
+		return;
+
+	for (unsigned int i=0; i < area.size(); i++) {
+		if (rules[i] && rules[i]->on)
+			b.set(i);
+	}
+}
+
 mask& mask::operator<< (const std::string &str)
 {
 	mask::add(str);
@@ -147,7 +509,8 @@ std::ostream& operator<< (std::ostream& s, const mask& mask)
 
 mask::mask()
 {
-	_list = new data_list;
+	_list  = new data_list;
+	_cache = new cache;
 
 	dprint("created mask %p list %p", (void*)this, (void*)_list);
 }
@@ -171,13 +534,15 @@ mask::mask(const char *str,...) : mask()
 
 mask::mask(const mask &m)
 {
-	_list = new data_list(*m._list);
+	_list  = new data_list(*m._list);
+	_cache = new cache;
 	dprint("created mask %p (ro copy of %p) list %p", (void*)this, (void*)&m, (void*)_list);
 }
 
 mask::mask(mask &m)
 {
-	_list = new data_list(*m._list);
+	_list  = new data_list(*m._list);
+	_cache = new cache;
 	dprint("created mask %p (rw copy of %p) list %p", (void*)this, (void*)&m, (void*)_list);
 }
 
@@ -185,12 +550,14 @@ void mask::operator=(const mask &m)
 {
 	delete _list;
 	_list = new data_list(*m._list);
+	_cache->clear();
 }
 
 mask::~mask()
 {
 	dprint("deleted mask %p list %p", (void*)this, (void*)_list);
 	delete _list;
+	delete _cache;
 }
 
 } // namespace hogl
@@ -0,0 +1,79 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+
+#include "hogl/detail/overlay.hpp"
+#include "hogl/detail/barrier.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+overlay::overlay(const mask &m) :
+	next(0), _mask(m), _count(0)
+{
+	for (unsigned int i = 0; i < CAPACITY; i++)
+		_entry[i].area = 0;
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+overlay::~overlay()
+{
+	pthread_mutex_destroy(&_mutex);
+}
+
+// Compile the section bitmap for the area.
+// Shared rings may have several writers doing this at the same time,
+// entries are published only once they're complete.
+bool overlay::compile(const hogl::area *a, unsigned int s)
+{
+	pthread_mutex_lock(&_mutex);
+
+	unsigned int i, n = _count;
+	for (i = 0; i < n; i++) {
+		if (_entry[i].area == a)
+			break;
+	}
+
+	if (i == n) {
+		if (n == CAPACITY) {
+			pthread_mutex_unlock(&_mutex);
+			return false;
+		}
+
+		_mask.apply(*a, _entry[n].sect);
+		_entry[n].area = a;
+		barrier::memw();
+		_count = n + 1;
+	}
+
+	bool r = _entry[i].sect.test(s);
+	pthread_mutex_unlock(&_mutex);
+	return r;
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -0,0 +1,80 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <unistd.h>
+#include <string>
+
+#include "hogl/detail/internal.hpp"
+#include "hogl/percpu.hpp"
+#include "hogl/post.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+percpu::percpu(const char *name, const ringbuf::options &opts, engine *engine) :
+	_engine(engine), _rings(nullptr), _count(0)
+{
+	long n = sysconf(_SC_NPROCESSORS_CONF);
+	if (n < 1)
+		n = 1;
+
+	ringbuf::options ropts = opts;
+	ropts.flags |= ringbuf::SHARED;
+
+	ringbuf **rings = new ringbuf* [n];
+	for (long i = 0; i < n; i++) {
+		std::string rname(name);
+		rname += ".CPU" + std::to_string(i);
+
+		rings[i] = engine->add_ring(rname.c_str(), ropts);
+		if (!rings[i]) {
+			// The engine logs an error. Drop the rings we've got so far.
+			while (i--)
+				rings[i]->release();
+			delete [] rings;
+			return;
+		}
+	}
+
+	_rings = rings;
+	_count = n;
+
+	hogl::post(_engine->internal_area(), internal::TLS_DEBUG,
+		"created percpu %p. rings %s.CPU* count %u", this, name, _count);
+}
+
+percpu::~percpu()
+{
+	if (!valid())
+		return;
+
+	for (unsigned int i = 0; i < _count; i++)
+		_rings[i]->release();
+	delete [] _rings;
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -25,6 +25,8 @@
 */
 
 #include "hogl/detail/post.hpp"
+#include "hogl/detail/limiter.hpp"
+#include "hogl/detail/overlay.hpp"
 
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
@@ -84,15 +86,44 @@ __hogl_post_impl_attrs void finish_locked(ringbuf *ring)
 	ring->unlock();
 }
 
+/**
+ * Finish posting the record that holds borrowed data.
+ * The engine releases the data once it's done with the record.
+ * Dropped records never make it to the engine, their data is released right away.
+ */
+static void finish_borrowed(ringbuf *ring, record *r)
+{
+	ring->set_borrows();
+	if (!ring->push_commit())
+		r->release_borrowed();
+}
+
+/**
+ * Discard the record that is not posted (disabled section, rate limit, etc).
+ * Releases borrowed data.
+ */
+void discard(uint64_t argtype, const argpack_item *item)
+{
+	unsigned int i = 0;
+	for (uint64_t t = argtype; t; t >>= 4, i++) {
+		if ((t & 0xf) != arg::BORROW)
+			continue;
+		unsigned int len;
+		const arg_borrow *b = (const arg_borrow *) item[i].data(len);
+		b->release(b->ptr, b->ctx);
+	}
+}
+
 /**
  * Begin posting new record. Unlocked version that uses TLS ring.
  * This function gets a new record form the ring and populate common fields
  * @return log record being pushed.
  */
-__hogl_post_impl_attrs void unlocked(ringbuf *ring, const area *a, unsigned int s, const argpack &ap)
+__hogl_post_impl_attrs void unlocked(ringbuf *ring, const area *a, unsigned int s, uint64_t argtype, const argpack_item *item)
 {
 	record *r = begin_unlocked(ring, a, s);
-	r->set_args(ring->record_tailroom(), ap);
+	if (hogl_unlikely(r->set_packed_args(ring->record_tailroom(), argtype, item, ring->arena(), !ring->overwrites())))
+		return finish_borrowed(ring, r);
 	finish_unlocked(ring);
 }
 
@@ -101,13 +132,68 @@ __hogl_post_impl_attrs void unlocked(ringbuf *ring, const area *a, unsigned int
  * This function gets a new record form the ring and populate common fields
  * @return log record being pushed.
  */
-__hogl_post_impl_attrs void locked(ringbuf *ring, const area *a, unsigned int s, const argpack &ap)
+__hogl_post_impl_attrs void locked(ringbuf *ring, const area *a, unsigned int s, uint64_t argtype, const argpack_item *item)
 {
 	record *r = begin_locked(ring, a, s);
-	r->set_args(ring->record_tailroom(), ap);
+	if (hogl_unlikely(r->set_packed_args(ring->record_tailroom(), argtype, item, ring->arena(), !ring->overwrites()))) {
+		finish_borrowed(ring, r);
+		ring->unlock();
+		return;
+	}
 	finish_locked(ring);
 }
 
+/**
+ * Check rate limit for the rate limited section.
+ * Called only for the sections that have a limit configured.
+ * @return true if the record should be posted, false if it's suppressed.
+ */
+bool admit(ringbuf *ring, const area *a, unsigned int s)
+{
+	ring->lock();
+	bool ok = admit_unlocked(ring, a, s);
+	ring->unlock();
+	return ok;
+}
+
+/**
+ * Check rate limit. Unlocked version for the callers that
+ * already hold the ring lock (see batch).
+ */
+bool admit_unlocked(ringbuf *ring, const area *a, unsigned int s)
+{
+	hogl::timesource *ts = ring->timesource();
+	return ring->limiter()->admit(a, s, ts->convert(ts->timestamp()));
+}
+
+/**
+ * Check if the section is enabled by the ring's mask overlay.
+ * Called only for the rings that have an overlay and only when
+ * the section is disabled globally.
+ */
+bool overlaid(ringbuf *ring, const area *a, unsigned int s)
+{
+	unsigned int e = ring->overlay_read_lock();
+	hogl::overlay *o = ring->overlay();
+	bool r = o && o->test(a, s);
+	ring->overlay_read_unlock(e);
+	return r;
+}
+
+/**
+ * Check if the section is recorded by the ring's flight recorder.
+ * Recorded sections are selected by the recorder's own overlay.
+ */
+bool recorded(ringbuf *ring, const area *a, unsigned int s)
+{
+	ringbuf *rec = ring->recorder();
+	unsigned int e = rec->overlay_read_lock();
+	hogl::overlay *o = rec->overlay();
+	bool r = o && o->test(a, s);
+	rec->overlay_read_unlock(e);
+	return r;
+}
+
 } // namespace post_impl
 } // namespace hogl
 __HOGL_PRIV_NS_CLOSE__
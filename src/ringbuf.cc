@@ -32,6 +32,10 @@
 #include <stdexcept>
 
 #include "hogl/detail/ringbuf.hpp"
+#include "hogl/detail/limiter.hpp"
+#include "hogl/detail/overlay.hpp"
+#include "hogl/detail/ringmem.hpp"
+#include "hogl/detail/arena.hpp"
 #include "hogl/fmt/printf.h"
 
 #ifdef HOGL_DEBUG
@@ -74,25 +78,51 @@ static unsigned int __roundup_power2(unsigned int size)
 	return (1 << __roundup_log2(size));
 }
 
+// Free a list of retired overlays
+static void free_overlays(hogl::overlay *o)
+{
+	while (o) {
+		hogl::overlay *n = o->next;
+		delete o;
+		o = n;
+	}
+}
+
 /**
  * Allocate ringbuf with specified options
  */
-ringbuf::ringbuf(const char *name, const options &opts) :
-	_refcnt(0), _block_active(0)
+ringbuf::ringbuf(const char *name, const options &opts, hogl::ringmem *mem) :
+	_mem(mem), _arena(0), _refcnt(0), _block_seq(0), _block_waiters(0), _block_spin(MIN_BLOCK_SPIN)
 {
 	int err;
 
 	_magic    = hogl::ring_magic;
 	_name     = strdup(name);
+	_name_len = strlen(_name);
 	_flags    = opts.flags;
 	_seqnum   = 0;
+	_ack_seqnum = 0;
 	_dropcnt  = 0;
+	_borrows  = false;
 	_timesource = &default_timesource;
+	_ts_clock   = default_timesource.builtin();
+	_limiter  = 0;
+	_overlay  = 0;
+	_overlay_retired = 0;
+	_overlay_retired_old = 0;
+	_overlay_epoch = 0;
+	_overlay_readers[0] = _overlay_readers[1] = 0;
+	_recorder = 0;
+	_activity = 0;
+	_activity_slot = 0;
 
 	_prio = opts.prio;
 	if (_prio > PRIORITY_CEILING)
 		_prio = PRIORITY_CEILING;
 
+	_budget      = opts.budget;
+	_max_latency = opts.max_latency_usec;
+
 	// Compute the desired capacity.
 	// This field is used as a mask for advancing head and tail indexes
 	// hence the decrement. ie tail = ((tail + 1) & capacity).
@@ -113,14 +143,31 @@ ringbuf::ringbuf(const char *name, const options &opts) :
 	// At this point this->record_size() and this->capacity() functions
 	// return correct values. Use them below.
 
-	// Allocate record buffers
+	// Allocate record buffers.
+	// The rest of the ring is initialized even if this fails so that it
+	// can be destroyed normally. See allocated().
 	_rec_top = 0;
-	err = posix_memalign((void **) &_rec_top, sysconf(_SC_PAGESIZE), capacity() * record_size());
-	if (err && !_rec_top) {
+	if (_mem) {
+		_rec_top = (uint8_t *) _mem->alloc(capacity() * record_size());
+		if (_rec_top)
+			_mem->hold();
+		else
+			_mem = 0;
+	} else {
+		err = posix_memalign((void **) &_rec_top, sysconf(_SC_PAGESIZE), capacity() * record_size());
+		if (err)
+			_rec_top = 0;
+	}
+
+	if (_rec_top)
+		memset(_rec_top, 0, capacity() * record_size());
+	else {
 		_capacity = 0;
-		return;
+		_head = 0;
 	}
-	memset(_rec_top, 0, capacity() * record_size());
+
+	set_reserve(opts.reserve);
+	set_arena(opts.arena_size);
 
 	// Init ringbuf mutex.
 	// Enable priority inherintance.
@@ -137,29 +184,136 @@ ringbuf::ringbuf(const char *name, const options &opts) :
 		throw std::runtime_error("hogl::ring: failed to init ring mutex.");
 	}
 
-	err = pthread_mutex_init(&_block_mutex, &mattr);
-	if (err) {
-		fmt::fprintf(stderr, "hogl::ring: failed to init ring block mutex. err %u\n", err);
-		throw std::runtime_error("hogl::ring: failed to init ring block mutex.");
+	pthread_mutexattr_destroy(&mattr);
+
+	dprint("created ringbuf %p. name %s capacity %u prio %u", (void*)this, _name, _capacity, _prio);
+}
+
+// Reserved room must leave some room for the normal records.
+// Recorder rings never run out of room and do not reserve any.
+void ringbuf::set_reserve(unsigned int n)
+{
+	_reserve = n;
+	if (_reserve >= _capacity)
+		_reserve = _capacity / 2;
+	if (overwrites())
+		_reserve = 0;
+}
+
+// Recorder rings overwrite records that the reader has not seen,
+// the arena space would never be released. They truncate instead.
+void ringbuf::set_arena(unsigned int size)
+{
+	if (overwrites() || !_rec_top)
+		size = 0;
+
+	if (_arena && _arena->size() >= size && size) {
+		_arena->reset();
+		return;
 	}
 
-	pthread_mutexattr_destroy(&mattr);
+	delete _arena;
+	_arena = 0;
 
-	pthread_cond_init(&_block_cond, NULL);
+	if (size) {
+		_arena = new hogl::arena(size);
+		if (!_arena->allocated()) {
+			delete _arena;
+			_arena = 0;
+		}
+	}
+}
 
-	dprint("created ringbuf %p. name %s capacity %u prio %u", (void*)this, _name, _capacity, _prio);
+void ringbuf::release_arena(uint64_t seqnum)
+{
+	_arena->release(seqnum);
+}
+
+// Release borrowed data held by the records that are still in the ring
+void ringbuf::release_borrowed()
+{
+	if (!_borrows || !_rec_top)
+		return;
+
+	for (unsigned int h = (_head + 1) & _capacity; h != _tail; h = (h + 1) & _capacity) {
+		record *r = get_record(h);
+		if (!r->special())
+			r->release_borrowed();
+	}
 }
 
 void ringbuf::reset(void)
 {
 	lock();
+	release_borrowed();
 	_tail = 0;
 	_head = _capacity;
 	_seqnum   = 0;
+	_ack_seqnum = 0;
 	_dropcnt  = 0;
+	if (_arena)
+		_arena->reset();
 	unlock();
 }
 
+bool ringbuf::fits(const options &opts) const
+{
+	unsigned int tailroom = 0;
+	if (opts.record_tailroom > record::argval_size())
+		tailroom = opts.record_tailroom - record::argval_size();
+
+	return _rec_top && (_capacity + 1) == __roundup_power2(opts.capacity) &&
+		_rec_shift == __roundup_log2(sizeof(record) + tailroom);
+}
+
+void ringbuf::recycle(const char *name, const options &opts)
+{
+	free(_name);
+	_name     = strdup(name);
+	_name_len = strlen(_name);
+	_flags    = opts.flags;
+	_seqnum   = 0;
+	_ack_seqnum = 0;
+	_dropcnt  = 0;
+	_borrows  = false;
+	_tail     = 0;
+	_head     = _capacity;
+
+	_prio = opts.prio;
+	if (_prio > PRIORITY_CEILING)
+		_prio = PRIORITY_CEILING;
+
+	_budget      = opts.budget;
+	_max_latency = opts.max_latency_usec;
+	set_reserve(opts.reserve);
+	set_arena(opts.arena_size);
+
+	_block_waiters = 0;
+	_block_spin    = MIN_BLOCK_SPIN;
+
+	_timesource = &default_timesource;
+	_ts_clock   = default_timesource.builtin();
+
+	delete _limiter;
+	_limiter = 0;
+
+	delete _overlay;
+	_overlay = 0;
+	free_overlays(_overlay_retired);
+	free_overlays(_overlay_retired_old);
+	_overlay_retired = _overlay_retired_old = 0;
+
+	if (_recorder) {
+		_recorder->release();
+		_recorder = 0;
+	}
+
+	_activity = 0;
+	_activity_slot = 0;
+
+	dprint("recycled ringbuf %p. name %s capacity %u prio %u", (void*)this, _name, _capacity, _prio);
+}
+
 ringbuf::~ringbuf()
 {
 	if (_refcnt.get() != 0) {
@@ -168,18 +322,30 @@ ringbuf::~ringbuf()
 		abort();
 	}
 
-	if (!empty()) {
+	if (!empty() && !overwrites()) {
 		fmt::fprintf(stderr, "hogl::ring: warning: destroying non-empty ringbuf %s(%p)\n", 
 			_name, (void*)this);
+		release_borrowed();
 	}
 
-	pthread_cond_destroy(&_block_cond);
-	pthread_mutex_destroy(&_block_mutex);
 	pthread_mutex_destroy(&_mutex);
 
 	dprint("destroyed ringbuf %p. name %s (empty %u)", (void*)this, _name, empty());
 
-	free(_rec_top);
+	if (_recorder)
+		_recorder->release();
+
+	delete _limiter;
+	delete _arena;
+	delete _overlay;
+	free_overlays(_overlay_retired);
+	free_overlays(_overlay_retired_old);
+
+	if (_mem) {
+		_mem->free(_rec_top, capacity() * record_size());
+		_mem->release();
+	} else
+		free(_rec_top);
 	free(_name);
 }
 
@@ -189,14 +355,205 @@ void ringbuf::timesource(hogl::timesource *ts)
 	// struct before we start using it.
 	barrier::memw();
 
+	// Writers use the pointer only for the custom clocks.
+	// Update it first so that it's valid once they see CUSTOM id.
 	_timesource = ts;
+	barrier::memw();
+	_ts_clock = ts->builtin();
+}
+
+void ringbuf::block(unsigned int want)
+{
+	// Spin first. The engine is likely in the middle of a pass
+	// and will free some room shortly. Spin count adapts to how often
+	// spinning pays off.
+	unsigned int spin = _block_spin;
+	for (unsigned int i = 0; i < spin; i++) {
+		if (room() > want) {
+			if (spin < MAX_BLOCK_SPIN)
+				_block_spin = spin * 2;
+			return;
+		}
+		futex::spin_pause();
+	}
+	if (spin > MIN_BLOCK_SPIN)
+		_block_spin = spin / 2;
+
+	int seq = _block_seq;
+	_block_waiters = 1;
+
+	// Pairs with the barrier in unblock()
+	barrier::memrw();
+	if (room() > want) {
+		// Not going to sleep, don't make the engine wake us up
+		_block_waiters = 0;
+		return;
+	}
+
+	// Make sure the engine does not sleep while we're stuck
+	hogl::activity *a = _activity;
+	if (a)
+		a->wake();
+
+	futex::wait(&_block_seq, seq);
+}
+
+void ringbuf::wake_writer()
+{
+	_block_waiters = 0;
+	__sync_fetch_and_add(&_block_seq, 1);
+	futex::wake(&_block_seq);
+}
+
+hogl::limiter *ringbuf::limiter()
+{
+	if (hogl_unlikely(!_limiter)) {
+		hogl::limiter *l = new hogl::limiter();
+
+		// Make sure the limiter is initialized before the engine sees it
+		barrier::memw();
+		_limiter = l;
+	}
+	return _limiter;
+}
+
+// Overlay updates are serialized by the ring mutex, even for the rings
+// that are not shared, because the engine reclaims retired overlays.
+void ringbuf::set_overlay(const hogl::mask &m)
+{
+	hogl::overlay *o = new hogl::overlay(m);
+
+	pthread_mutex_lock(&_mutex);
+
+	// Make sure the overlay is initialized before the writers see it
+	barrier::memw();
+
+	hogl::overlay *old = _overlay;
+	_overlay = o;
+	if (old) {
+		__sync_synchronize();
+		old->next = _overlay_retired;
+		_overlay_retired = old;
+	}
+	try_reclaim_overlays();
+
+	pthread_mutex_unlock(&_mutex);
+}
+
+void ringbuf::clear_overlay()
+{
+	pthread_mutex_lock(&_mutex);
+
+	hogl::overlay *old = _overlay;
+	_overlay = 0;
+	if (old) {
+		__sync_synchronize();
+		old->next = _overlay_retired;
+		_overlay_retired = old;
+	}
+	try_reclaim_overlays();
+
+	pthread_mutex_unlock(&_mutex);
+}
+
+// Free overlays retired in the previous epoch if all writers from
+// that epoch are gone, and start the new epoch.
+// Called under the ring mutex.
+void ringbuf::try_reclaim_overlays()
+{
+	if (!_overlay_retired && !_overlay_retired_old)
+		return;
+
+	if (_overlay_readers[(_overlay_epoch - 1) & 1])
+		return;
+
+	free_overlays(_overlay_retired_old);
+	_overlay_retired_old = _overlay_retired;
+	_overlay_retired = 0;
+	__sync_fetch_and_add(&_overlay_epoch, 1);
+}
+
+void ringbuf::reclaim_overlays()
+{
+	if (pthread_mutex_trylock(&_mutex))
+		return;
+	try_reclaim_overlays();
+	pthread_mutex_unlock(&_mutex);
+}
+
+bool ringbuf::recorder(ringbuf *r)
+{
+	lock();
+
+	bool ok = !_recorder;
+	if (ok) {
+		r->hold();
+
+		// Make sure the recorder is set up before the writers see it
+		barrier::memw();
+		_recorder = r;
+	}
+
+	unlock();
+	return ok;
+}
+
+// The writer moves the head past the oldest record before reusing its slot.
+// Records copied before the head got to them are intact. The seqnum delta
+// tells us if the writer went all the way around the ring while we were
+// copying, in which case the head position is ambiguous and we try again.
+unsigned int ringbuf::snapshot(uint8_t *buf, unsigned int max) const
+{
+	const unsigned int rsize = record_size();
+
+	for (unsigned int attempt = 0; attempt < 3; attempt++) {
+		// Tail first. The head can only move forward after that, which
+		// shrinks the window.
+		uint64_t seq = _seqnum;
+		barrier::memr();
+		unsigned int t = _tail;
+		barrier::memr();
+		unsigned int h = _head;
+
+		unsigned int n = (t - h - 1) & _capacity;
+		if (n > max)
+			n = max;
+
+		unsigned int first = (t - n) & _capacity;
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int s = (first + i) & _capacity;
+			memcpy(buf + i * rsize, _rec_top + (s << _rec_shift), rsize);
+		}
+
+		barrier::memr();
+		unsigned int moved = (_head - h) & _capacity;
+		barrier::memr();
+		if (_seqnum - seq + 2 > _capacity)
+			continue;
+
+		// Records up to the current head (inclusive) may have been overwritten
+		unsigned int skip = (first - h - 1) & _capacity;
+		if (moved <= skip)
+			return n;
+		unsigned int lost = moved - skip;
+		if (lost >= n)
+			return 0;
+		memmove(buf, buf + lost * rsize, (n - lost) * rsize);
+		return n - lost;
+	}
+
+	return 0;
 }
 
 ringbuf::options ringbuf::default_options = {
 	.capacity = 1024,
 	.prio = 0,
 	.flags = 0,
-	.record_tailroom = 128
+	.record_tailroom = 128,
+	.budget = 0,
+	.max_latency_usec = 0,
+	.reserve = 0,
+	.arena_size = 0
 };
 
 std::ostream& operator<< (std::ostream& s, const ringbuf& ring)
@@ -207,6 +564,10 @@ std::ostream& operator<< (std::ostream& s, const ringbuf& ring)
 
 	s << "" << ring.name() << ": { "
 		<< "prio:"     << ring.prio()     << ", "
+		<< "budget:"   << ring.budget()   << ", "
+		<< "max_latency_usec:" << ring.max_latency_usec() << ", "
+		<< "reserve:"  << ring.reserve()  << ", "
+		<< "arena_size:" << (ring.arena() ? ring.arena()->size() : 0) << ", "
 		<< "refcnt:"   << ring.refcnt()   << ", "
 		<< "seqnum:"   << ring.seqnum()   << ", "
 		<< "dropcnt:"  << ring.dropcnt()  << ", "
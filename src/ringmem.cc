@@ -0,0 +1,153 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hogl/detail/ringmem.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+ringmem::ringmem(size_t limit) :
+	_refcnt(1), _limit(limit), _reserved(0), _used(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+ringmem::~ringmem()
+{
+	// Rings hold references, nothing can be left here
+	pthread_mutex_destroy(&_mutex);
+}
+
+static unsigned int __log2(size_t size)
+{
+	unsigned int i;
+	for (i=0; ((size_t) 1 << i) < size; i++);
+	return i;
+}
+
+void *ringmem::alloc(size_t size)
+{
+	void *p = 0;
+
+	pthread_mutex_lock(&_mutex);
+
+	if (size >= CHUNK_SIZE) {
+		// Large buffer, straight from the system
+		if (fits(size) && !posix_memalign(&p, sysconf(_SC_PAGESIZE), size)) {
+			_reserved += size;
+			_used     += size;
+		}
+		pthread_mutex_unlock(&_mutex);
+		return p;
+	}
+
+	std::vector<chunk *> &slab = _slab[__log2(size)];
+
+	chunk *c = 0;
+	for (unsigned int i = 0; i < slab.size(); i++) {
+		if (slab[i]->free) {
+			c = slab[i];
+			break;
+		}
+	}
+
+	if (!c) {
+		// New chunk. Chunks are aligned to their size, which makes
+		// it easy to find the chunk a buffer belongs to.
+		void *base = 0;
+		if (!fits(CHUNK_SIZE) || posix_memalign(&base, CHUNK_SIZE, CHUNK_SIZE)) {
+			pthread_mutex_unlock(&_mutex);
+			return 0;
+		}
+
+		c = new chunk;
+		c->base = (uint8_t *) base;
+		c->free = 0;
+		c->used = 0;
+		for (size_t off = CHUNK_SIZE; off >= size; off -= size) {
+			void **b = (void **) (c->base + off - size);
+			*b = c->free;
+			c->free = b;
+		}
+
+		slab.push_back(c);
+		_chunks[(uintptr_t) base] = c;
+		_reserved += CHUNK_SIZE;
+	}
+
+	p = c->free;
+	c->free = *(void **) p;
+	c->used++;
+	_used += size;
+
+	pthread_mutex_unlock(&_mutex);
+	return p;
+}
+
+void ringmem::free(void *p, size_t size)
+{
+	pthread_mutex_lock(&_mutex);
+
+	_used -= size;
+
+	if (size >= CHUNK_SIZE) {
+		::free(p);
+		_reserved -= size;
+		pthread_mutex_unlock(&_mutex);
+		return;
+	}
+
+	std::map<uintptr_t, chunk*>::iterator it = _chunks.find((uintptr_t) p & ~((uintptr_t) CHUNK_SIZE - 1));
+	chunk *c = it->second;
+
+	*(void **) p = c->free;
+	c->free = p;
+
+	if (!--c->used) {
+		// Give the chunk back to the system
+		std::vector<chunk *> &slab = _slab[__log2(size)];
+		for (unsigned int i = 0; i < slab.size(); i++) {
+			if (slab[i] == c) {
+				slab.erase(slab.begin() + i);
+				break;
+			}
+		}
+		_chunks.erase(it);
+		::free(c->base);
+		delete c;
+		_reserved -= CHUNK_SIZE;
+	}
+
+	pthread_mutex_unlock(&_mutex);
+}
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -0,0 +1,85 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "hogl/detail/strcopy.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+#if defined(__SSE2__)
+
+unsigned int strcopy(uint8_t *dst, const uint8_t *src, unsigned int max)
+{
+	unsigned int i = 0;
+
+	// Scalar head until the source is 16 byte aligned. Aligned loads never
+	// cross a page boundary, so we can safely read past the null terminator.
+	while (i < max && ((uintptr_t) (src + i) & 15)) {
+		if (!src[i]) return i;
+		dst[i] = src[i];
+		i++;
+	}
+
+	const __m128i z = _mm_setzero_si128();
+	while (i < max) {
+		__m128i  v = _mm_load_si128((const __m128i *) (src + i));
+		unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, z));
+		unsigned n = max - i;
+		if (m) {
+			unsigned int k = __builtin_ctz(m);
+			if (k < n) n = k;
+		}
+		if (n >= 16) {
+			_mm_storeu_si128((__m128i *) (dst + i), v);
+			i += 16;
+			continue;
+		}
+		memcpy(dst + i, src + i, n);
+		return i + n;
+	}
+	return i;
+}
+
+#else
+
+unsigned int strcopy(uint8_t *dst, const uint8_t *src, unsigned int max)
+{
+	unsigned int i;
+	for (i = 0; i < max && src[i]; i++)
+		dst[i] = src[i];
+	return i;
+}
+
+#endif
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
@@ -36,21 +36,111 @@
 __HOGL_PRIV_NS_OPEN__
 namespace hogl {
 
-timesource::timesource(const char *name, callback cb)
-	: _callback(cb), _name(strdup(name))
-{ }
+timesource::timesource(const char *name, callback cb, calibrator cal, builtin_clock clk)
+	: _callback(cb), _name(strdup(name)), _calibrator(cal), _builtin(clk), _scale_seq(0)
+{
+	memset(&_scale, 0, sizeof(_scale));
+	memset(&_last_cal, 0, sizeof(_last_cal));
+	pthread_mutex_init(&_cal_mutex, NULL);
+}
 
 timesource::timesource(const timesource &ts)
-	: _callback(ts._callback), _name(strdup(ts._name))
-{ }
+	: _callback(ts._callback), _name(strdup(ts._name)), _calibrator(ts._calibrator),
+		_builtin(ts._builtin), _scale_seq(0)
+{
+	_scale = ts.get_scale();
+	_last_cal = ts._last_cal;
+	pthread_mutex_init(&_cal_mutex, NULL);
+}
 
 timesource::~timesource()
 {
+	pthread_mutex_destroy(&_cal_mutex);
 	free(_name);
 }
 
+// Check if the scale was refreshed within the last second
+bool timesource::fresh(const scale &s) const
+{
+	if (!s.mult)
+		return false;
+	uint64_t t = convert_raw(timestamp()).to_nsec();
+	return t >= s.base_nsec && t - s.base_nsec < 1000000000;
+}
+
+bool timesource::calibrate()
+{
+	if (!_calibrator || fresh(get_scale()))
+		return false;
+
+	// Engines sharing the timesource calibrate it one at a time.
+	// Whoever comes second finds a fresh scale and skips.
+	pthread_mutex_lock(&_cal_mutex);
+
+	scale s = get_scale();
+	if (fresh(s)) {
+		pthread_mutex_unlock(&_cal_mutex);
+		return false;
+	}
+
+	_calibrator(this);
+	bool updated = get_scale().base_raw != s.base_raw;
+
+	pthread_mutex_unlock(&_cal_mutex);
+	return updated;
+}
+
+timesource::scale timesource::get_scale() const
+{
+	scale s;
+	unsigned int seq;
+	do {
+		seq = _scale_seq;
+		barrier::memr();
+		s = _scale;
+		barrier::memr();
+	} while ((seq & 1) || seq != _scale_seq);
+	return s;
+}
+
+void timesource::set_scale(const scale &s)
+{
+	// Timesource may be shared by several engines.
+	// Odd seqcount doubles as the writer lock.
+	unsigned int seq;
+	do {
+		seq = _scale_seq & ~1u;
+	} while (!__sync_bool_compare_and_swap(&_scale_seq, seq, seq + 1));
+
+	barrier::memw();
+	_scale = s;
+	barrier::memw();
+	_scale_seq = seq + 2;
+}
+
+hogl::timestamp timesource::convert_raw(hogl::timestamp t) const
+{
+	scale s = get_scale();
+
+	// Signed delta handles the timestamps taken slightly before 
+	// the current base.
+	int64_t d = (int64_t) (t.to_nsec() - s.base_raw);
+
+	#ifdef __SIZEOF_INT128__
+	int64_t nsec = ((__int128_t) d * s.mult) >> scale::SHIFT;
+	#else
+	// Split the multiplication to avoid overflows
+	uint64_t a = d < 0 ? -d : d;
+	int64_t nsec = (int64_t) ((a >> scale::SHIFT) * s.mult + (((a & 0xffffffff) * s.mult) >> scale::SHIFT));
+	if (d < 0) nsec = -nsec;
+	#endif
+
+	return hogl::timestamp(s.base_nsec + nsec);
+}
+
 // Comes from flush.cc
 extern bool timeout(uint64_t &to, uint64_t usec);
+extern bool wait_ack(ringbuf *ring, uint64_t seq, uint64_t &to, uint64_t to_usec);
 
 // Note: This implementation is not self contained. 
 // It assumes that the engine (or something else) that is poping 
@@ -80,12 +170,7 @@ static bool do_change_timesource(ringbuf *ring, timesource *ts, uint64_t to_usec
 		return true;
 
 	// Wait for it to get acked
-	while (!r->acked()) {
-		if (timeout(to, to_usec))
-			return false;
-	}
-
-	return true;
+	return wait_ack(ring, seq, to, to_usec);
 }
 
 bool change_timesource(ringbuf *ring, timesource *ts, unsigned int to_usec)
@@ -41,6 +41,11 @@ namespace hogl {
  */
 thread_local ringbuf *tls::_ring = &default_ring;
 
+/**
+ * Per thread per-CPU ring set pointer
+ */
+thread_local percpu *tls::_percpu = nullptr;
+
 /**
  * Update TLS ring pointer.
  * Private helper used from constructors.
@@ -61,7 +66,8 @@ void tls::update(ringbuf *r)
  * TLS constructor
  */
 tls::tls(const char *name, ringbuf::options &opts, engine *engine) :
-	_engine(engine), _previous_ring(nullptr), _current_ring(nullptr)
+	_engine(engine), _previous_ring(nullptr), _current_ring(nullptr),
+	_previous_percpu(nullptr), _current_percpu(nullptr)
 {
 	ringbuf *r = engine->add_ring(name, opts);
 	if (!r) {
@@ -76,11 +82,27 @@ tls::tls(const char *name, ringbuf::options &opts, engine *engine) :
 }
 
 tls::tls(ringbuf *r, engine *engine) :
-	_engine(engine), _previous_ring(nullptr), _current_ring(nullptr)
+	_engine(engine), _previous_ring(nullptr), _current_ring(nullptr),
+	_previous_percpu(nullptr), _current_percpu(nullptr)
 {
 	update(r);
 }
 
+tls::tls(percpu &p, engine *engine) :
+	_engine(engine), _previous_ring(nullptr), _current_ring(nullptr),
+	_previous_percpu(nullptr), _current_percpu(nullptr)
+{
+	// Same as above, keep using the current ring if the set is broken
+	if (!p.valid())
+		return;
+
+	hogl::post(_engine->internal_area(), internal::TLS_DEBUG,
+		"created tls %p. percpu %p", this, &p);
+
+	_previous_percpu = _percpu;
+	_percpu = _current_percpu = &p;
+}
+
 tls::~tls()
 {
 	// Looks like allocation failed in the constructor
@@ -89,6 +111,15 @@ tls::~tls()
 		return;
 	}
 
+	if (_current_percpu) {
+		// Set per-CPU pointer back to the previous set
+		_percpu = _previous_percpu;
+
+		hogl::post(_engine->internal_area(), internal::TLS_DEBUG,
+			"destroyed tls %p percpu %p", this, _current_percpu);
+		return;
+	}
+
 	// Set TLS ring pointer back to the previous ring
 	_ring = _previous_ring;
 
@@ -105,7 +136,8 @@ tls::~tls()
 #if defined(__QNXNTO__)
 // QNX TLS implementation is broken for shared libraries.
 // Out-of-line version here is a workaround.
-ringbuf* tls::ring() { return _ring; }
+ringbuf* tls::ring() { return _percpu ? _percpu->ring() : _ring; }
+percpu* tls::cpu_rings() { return _percpu; }
 #endif
 
 } // namespace hogl
@@ -0,0 +1,152 @@
+/*
+   Copyright (c) 2015-2020 Max Krasnyansky <max.krasnyansky@gmail.com> 
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   1. Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+   
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include "hogl/detail/timesource.hpp"
+
+__HOGL_PRIV_NS_OPEN__
+namespace hogl {
+
+static hogl::timestamp tsc_fallback(const hogl::timesource *)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return hogl::timestamp(ts);
+}
+
+#if defined(__x86_64__)
+
+// TSC is usable only if it runs at the constant rate and does not stop 
+// in the deep C-states (aka invariant TSC).
+static bool invariant_tsc()
+{
+	unsigned int a, b, c, d;
+	if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007)
+		return false;
+	__get_cpuid(0x80000007, &a, &b, &c, &d);
+	return d & (1 << 8);
+}
+
+static hogl::timestamp tsc_read(const hogl::timesource *)
+{
+	return hogl::timestamp(__rdtsc());
+}
+
+static uint64_t clock_nsec(clockid_t clk)
+{
+	struct timespec ts;
+	clock_gettime(clk, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Take a sample with the smallest TSC window around the clock reads.
+static timesource::cal_point take_sample()
+{
+	timesource::cal_point s = {};
+	uint64_t best = ~0ULL;
+	for (unsigned int i = 0; i < 5; i++) {
+		uint64_t t0 = __rdtsc();
+		uint64_t rt = clock_nsec(CLOCK_REALTIME);
+		uint64_t mt = clock_nsec(CLOCK_MONOTONIC_RAW);
+		uint64_t t1 = __rdtsc();
+		if (t1 - t0 < best) {
+			best = t1 - t0;
+			s.raw = t0 + (t1 - t0) / 2;
+			s.realtime  = rt;
+			s.monotonic = mt;
+		}
+	}
+	return s;
+}
+
+// Frequency is measured against the monotonic raw clock over the
+// time since the previous calibration (or initial 10 msec spin), which
+// keeps it stable when the realtime clock gets stepped. 
+// Offset is taken from the realtime clock on every calibration.
+static void tsc_calibrate(hogl::timesource *self)
+{
+	timesource::scale sc = self->get_scale();
+	timesource::cal_point &anchor = self->last_cal();
+
+	if (!sc.mult) {
+		anchor = take_sample();
+		struct timespec ts = { 0, 10 * 1000 * 1000 };
+		nanosleep(&ts, 0);
+	}
+
+	timesource::cal_point s = take_sample();
+	uint64_t dt = s.raw - anchor.raw;
+	uint64_t dm = s.monotonic - anchor.monotonic;
+	if (!dt || !dm)
+		return;
+
+	sc.mult = ((__uint128_t) dm << timesource::scale::SHIFT) / dt;
+	sc.base_raw  = s.raw;
+	sc.base_nsec = s.realtime;
+	self->set_scale(sc);
+
+	anchor = s;
+}
+
+static timesource::callback tsc_callback()
+{
+	return invariant_tsc() ? tsc_read : tsc_fallback;
+}
+
+static timesource::calibrator tsc_calibrator()
+{
+	return invariant_tsc() ? tsc_calibrate : 0;
+}
+
+static timesource::builtin_clock tsc_clock()
+{
+	return invariant_tsc() ? timesource::TSC : timesource::REALTIME;
+}
+
+#else
+
+static timesource::callback tsc_callback() { return tsc_fallback; }
+static timesource::calibrator tsc_calibrator() { return 0; }
+static timesource::builtin_clock tsc_clock() { return timesource::REALTIME; }
+
+#endif
+
+/**
+ * TSC timesource instance.
+ * Falls back to clock_realtime if invariant TSC is not available.
+ */
+timesource tsc_timesource("tsc", tsc_callback(), tsc_calibrator(), tsc_clock());
+
+} // namespace hogl
+__HOGL_PRIV_NS_CLOSE__
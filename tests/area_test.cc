@@ -140,3 +140,28 @@ BOOST_AUTO_TEST_CASE(default_sections)
 	std::cout << "---" << std::endl;
 	std::cout << d;
 }
+
+BOOST_AUTO_TEST_CASE(names)
+{
+	hogl::area area("DEF", sect_names);
+	hogl::area d("DEFSECT");
+
+	BOOST_REQUIRE(area.name_len() == 3);
+	BOOST_REQUIRE(d.name_len() == 7);
+
+	unsigned int i, len = 0;
+	for (i=0; i < area.size(); i++) {
+		BOOST_REQUIRE(area.section_name_len(i) == strlen(sect_names[i]));
+
+		const char *p = area.section_prefix(i, len);
+		BOOST_REQUIRE(std::string(p, len) == std::string("DEF:") + sect_names[i] + " ");
+	}
+
+	for (i=0; i < d.size(); i++) {
+		const char *p = d.section_prefix(i, len);
+		BOOST_REQUIRE(std::string(p, len) == std::string("DEFSECT:") + d.section_name(i) + " ");
+	}
+
+	BOOST_REQUIRE(area.section_prefix(NSECT, len) == 0);
+	BOOST_REQUIRE(area.section_name_len(NSECT) == strlen(area.section_name(NSECT)));
+}
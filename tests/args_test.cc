@@ -33,7 +33,12 @@
 #include <getopt.h>
 #include <sys/time.h>
 
+#include <string>
+#include <algorithm>
+
 #include "hogl/detail/args.hpp"
+#include "hogl/detail/record.hpp"
+#include "hogl/detail/strcopy.hpp"
 
 #define BOOST_TEST_MODULE area_test 
 #include <boost/test/included/unit_test.hpp>
@@ -50,7 +55,7 @@ BOOST_AUTO_TEST_CASE(basic)
 	hogl::arg a_ptr(&a_cstr);
 
 	BOOST_REQUIRE(a_cstr.type == hogl::arg::CSTR);
-	BOOST_REQUIRE(a_cstr.len  == strlen("string"));
+	BOOST_REQUIRE(a_cstr.len  == strlen("string") || a_cstr.len == hogl::arg::UNKNOWN_LEN);
 	BOOST_REQUIRE(a_gstr.type == hogl::arg::GSTR);
 
 	BOOST_REQUIRE(a_uint.type == hogl::arg::UINT32);
@@ -58,3 +63,60 @@ BOOST_AUTO_TEST_CASE(basic)
 	BOOST_REQUIRE(a_dbl.type  == hogl::arg::DOUBLE);
 	BOOST_REQUIRE(a_ptr.type  == hogl::arg::POINTER);
 }
+
+// Strings that are not known at compile time are measured while copying
+BOOST_AUTO_TEST_CASE(cstr_len)
+{
+	std::string s("runtime string");
+	hogl::arg a(s.c_str());
+	BOOST_REQUIRE(a.type == hogl::arg::CSTR);
+	BOOST_REQUIRE(a.len  == hogl::arg::UNKNOWN_LEN);
+
+	hogl::arg n((const char *) 0);
+	BOOST_REQUIRE(n.len == 0);
+}
+
+// Bounded copy must match the scalar version for all lengths and alignments
+BOOST_AUTO_TEST_CASE(strcopy)
+{
+	alignas(64) uint8_t src[256];
+	uint8_t dst[256];
+
+	for (unsigned int a = 0; a < 16; a++) {
+		for (unsigned int len = 0; len < 80; len++) {
+			memset(src, 'x', sizeof(src));
+			src[a + len] = '\0';
+			for (unsigned int max = 0; max < 96; max++) {
+				memset(dst, 0, sizeof(dst));
+				unsigned int n = hogl::strcopy(dst, src + a, max);
+				BOOST_REQUIRE(n == std::min(len, max));
+				BOOST_REQUIRE(!memcmp(dst, src + a, n));
+				BOOST_REQUIRE(dst[n] == 0);
+			}
+		}
+	}
+}
+
+// Long runtime strings are truncated to the record tailroom
+BOOST_AUTO_TEST_CASE(cstr_truncate)
+{
+	alignas(64) static uint8_t buf[sizeof(hogl::record) + 64];
+	const unsigned int tailroom = sizeof(buf) - hogl::record::header_size();
+
+	std::string s(1000, 'x');
+	hogl::record &r = *new (buf) hogl::record();
+	r.set_args(tailroom, s.c_str());
+
+	unsigned int len;
+	const uint8_t *d = r.get_arg_data(0, len);
+	BOOST_REQUIRE(len == tailroom - 8 - 1);
+	BOOST_REQUIRE(d[len] == '\0');
+	BOOST_REQUIRE(!memcmp(d + len - 3, ">>>", 3));
+	BOOST_REQUIRE(d[len - 4] == 'x');
+
+	std::string f("fits");
+	r.set_args(tailroom, f.c_str());
+	d = r.get_arg_data(0, len);
+	BOOST_REQUIRE(len == 4);
+	BOOST_REQUIRE(!strcmp((const char *) d, "fits"));
+}
@@ -32,10 +32,15 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "hogl/detail/engine.hpp"
 #include "hogl/output-stderr.hpp"
+#include "hogl/output-null.hpp"
 #include "hogl/format-basic.hpp"
+#include "hogl/post.hpp"
+#include "hogl/timesource.hpp"
+#include "hogl/flush.hpp"
 
 #define BOOST_TEST_MODULE engine_test 
 #include <boost/test/included/unit_test.hpp>
@@ -154,3 +159,773 @@ BOOST_AUTO_TEST_CASE(cpu_affinity_list)
 
 	std::cout << eng;
 }
+
+BOOST_AUTO_TEST_CASE(rate_limit)
+{
+	hogl::format_basic  format;
+	hogl::output_stderr output(format);
+
+	hogl::engine::options opts = {
+		.default_mask = hogl::mask(".*:(INFO|WARN|ERROR|FATAL).*", "XYZ:DEBUG@10/s", "XYZ:TRACE@1/100", 0),
+		.polling_interval_usec = 10000,
+		.tso_buffer_capacity =   4096,
+		.features = 0,
+		.schedparam = 0,
+		.timesource = 0
+	};
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("XYZ");
+	BOOST_REQUIRE(a->limited(hogl::area::DEBUG));
+	BOOST_REQUIRE(a->limited(hogl::area::TRACE));
+	BOOST_REQUIRE(!a->limited(hogl::area::INFO));
+
+	hogl::ringbuf *ring = eng.add_ring("RATE-LIMIT", hogl::ringbuf::default_options);
+	BOOST_REQUIRE(ring != 0);
+
+	for (unsigned int i = 0; i < 200; i++) {
+		hogl::post(ring, a, hogl::area::DEBUG, "debug record %u", i);
+		hogl::post(ring, a, hogl::area::TRACE, "trace record %u", i);
+	}
+
+	// Suppressed records are reported at most once per second
+	for (unsigned int i = 0; i < 300 && eng.get_stats().recs_suppressed != (190 + 198); i++)
+		usleep(10000);
+
+	BOOST_REQUIRE(eng.get_stats().recs_suppressed == (190 + 198));
+
+	ring->release();
+
+	std::cout << eng.get_stats();
+}
+
+static volatile bool lookup_stop;
+
+static void *lookup_thread(void *arg)
+{
+	hogl::engine *eng = (hogl::engine *) arg;
+	unsigned long n = 0;
+
+	while (!lookup_stop) {
+		char name[32];
+		sprintf(name, "AREA-%lu", n % 256);
+		eng->find_area(name);
+
+		sprintf(name, "RING-%lu", n % 256);
+		hogl::ringbuf *r = eng->find_ring(name);
+		if (r)
+			r->release();
+		n++;
+	}
+	return 0;
+}
+
+BOOST_AUTO_TEST_CASE(registry)
+{
+	hogl::format_basic  format;
+	hogl::output_stderr output(format);
+
+	hogl::engine eng(output);
+
+	lookup_stop = false;
+
+	pthread_t tid;
+	BOOST_REQUIRE(pthread_create(&tid, NULL, lookup_thread, &eng) == 0);
+
+	// Add areas and rings while the other thread is looking them up.
+	// Half of the rings are released right away and become orphans.
+	hogl::ringbuf *rings[256];
+	for (unsigned int i = 0; i < 256; i++) {
+		char name[32];
+		sprintf(name, "AREA-%u", i);
+		BOOST_REQUIRE(eng.add_area(name) != 0);
+
+		sprintf(name, "RING-%u", i);
+		rings[i] = eng.add_ring(name, hogl::ringbuf::default_options);
+		BOOST_REQUIRE(rings[i] != 0);
+		if (i & 1) {
+			rings[i]->release();
+			rings[i] = 0;
+		}
+	}
+
+	// Give the engine time to reap the orphans
+	usleep(200000);
+
+	lookup_stop = true;
+	pthread_join(tid, NULL);
+
+	for (unsigned int i = 0; i < 256; i++) {
+		char name[32];
+		sprintf(name, "AREA-%u", i);
+		const hogl::area *a = eng.find_area(name);
+		BOOST_REQUIRE(a != 0 && !strcmp(a->name(), name));
+
+		sprintf(name, "RING-%u", i);
+		hogl::ringbuf *r = eng.find_ring(name);
+		BOOST_REQUIRE((r != 0) == (rings[i] != 0));
+		if (r) {
+			BOOST_REQUIRE(r == rings[i]);
+			r->release();
+			rings[i]->release();
+		}
+	}
+
+	std::cout << eng.get_stats();
+}
+
+BOOST_AUTO_TEST_CASE(ring_churn)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.polling_interval_usec = 1000;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("CHURN");
+
+	hogl::string_list initial;
+	eng.list_rings(initial);
+
+	// Long-lived rings keep posting while short-lived ones come and go.
+	// Their seqnums must survive the index updates (no drops reported).
+	hogl::ringbuf::options ropts = { .capacity = 1024, .prio = 0, .flags = 0, .record_tailroom = 0 };
+	hogl::ringbuf *stable[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		char name[32];
+		sprintf(name, "STABLE-%u", i);
+		ropts.prio = i * 50;
+		stable[i] = eng.add_ring(name, ropts);
+		BOOST_REQUIRE(stable[i] != 0);
+	}
+
+	const unsigned int nrings = 10000, batch = 100;
+
+	ropts.capacity = 16;
+
+	struct timeval start, end;
+	gettimeofday(&start, 0);
+
+	for (unsigned int n = 0; n < nrings; n += batch) {
+		for (unsigned int i = n; i < n + batch; i++) {
+			char name[32];
+			sprintf(name, "CHURN-%u", i);
+			ropts.prio = i % 200;
+			hogl::ringbuf *r = eng.add_ring(name, ropts);
+			BOOST_REQUIRE(r != 0);
+			hogl::post(r, a, hogl::area::INFO, "churn %u", i);
+			r->release();
+		}
+
+		for (unsigned int i = 0; i < 4; i++)
+			hogl::post(stable[i], a, hogl::area::INFO, "stable %u", n);
+
+		usleep(1000);
+	}
+
+	for (unsigned int i = 0; i < 4; i++)
+		stable[i]->release();
+
+	// Wait for all the orphans to be flushed and removed
+	for (unsigned int i = 0; i < 500; i++) {
+		hogl::string_list l;
+		eng.list_rings(l);
+		if (l.size() == initial.size())
+			break;
+		usleep(10000);
+	}
+
+	gettimeofday(&end, 0);
+
+	hogl::string_list left;
+	eng.list_rings(left);
+	BOOST_REQUIRE(left.size() == initial.size());
+
+	const hogl::engine::stats &st = eng.get_stats();
+	BOOST_REQUIRE(st.recs_dropped == 0);
+	BOOST_REQUIRE(st.recs_out >= nrings + 4 * (nrings / batch));
+	BOOST_REQUIRE(st.ring_pool_hits > 0);
+
+	unsigned long msec = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+	std::cout << "churned " << nrings << " rings in " << msec << " msec" << std::endl;
+	std::cout << st;
+}
+
+BOOST_AUTO_TEST_CASE(ring_pool)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.polling_interval_usec = 1000;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("POOL");
+
+	hogl::ringbuf::options ropts = { .capacity = 64, .prio = 0, .flags = 0, .record_tailroom = 0 };
+	hogl::ringbuf *r = eng.add_ring("POOL-0", ropts);
+	for (unsigned int i = 0; i < 10; i++)
+		hogl::post(r, a, hogl::area::INFO, "pool %u", i);
+	r->release();
+
+	// Wait for the orphan to be drained and recycled
+	for (unsigned int i = 0; i < 500; i++) {
+		hogl::ringbuf *f = eng.find_ring("POOL-0");
+		if (!f)
+			break;
+		f->release();
+		usleep(10000);
+	}
+	usleep(20000);
+
+	// Same geometry comes from the pool, different one does not
+	unsigned long hits = eng.get_stats().ring_pool_hits;
+	hogl::ringbuf *r1 = eng.add_ring("POOL-1", ropts);
+	bool hit = eng.get_stats().ring_pool_hits == hits + 1;
+	bool clean = r1->empty() && !r1->seqnum() && !strcmp(r1->name(), "POOL-1");
+
+	ropts.capacity = 128;
+	hogl::ringbuf *r2 = eng.add_ring("POOL-2", ropts);
+	bool miss = eng.get_stats().ring_pool_hits == hits + 1 && r2->capacity() == 128;
+
+	r1->release();
+	r2->release();
+
+	std::cout << eng.get_stats();
+
+	BOOST_REQUIRE(hit);
+	BOOST_REQUIRE(clean);
+	BOOST_REQUIRE(miss);
+}
+
+BOOST_AUTO_TEST_CASE(ring_activity)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.polling_interval_usec = 1000;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("ACTIVITY");
+
+	hogl::ringbuf::options ropts = { .capacity = 256, .prio = 0, .flags = 0, .record_tailroom = 0 };
+
+	// Lots of idle rings and a single busy one
+	const unsigned int nidle = 200;
+	hogl::ringbuf *idle[nidle];
+	for (unsigned int i = 0; i < nidle; i++) {
+		char name[32];
+		sprintf(name, "IDLE-%u", i);
+		idle[i] = eng.add_ring(name, ropts);
+		BOOST_REQUIRE(idle[i] != 0);
+	}
+
+	hogl::ringbuf *busy = eng.add_ring("BUSY", ropts);
+	BOOST_REQUIRE(busy != 0);
+
+	// Let the engine index the rings
+	usleep(50000);
+
+	hogl::engine::stats s0 = eng.get_stats();
+
+	const unsigned int nrecs = 300;
+	for (unsigned int i = 0; i < nrecs; i++) {
+		hogl::post(busy, a, hogl::area::INFO, "busy %u", i);
+		usleep(500);
+	}
+
+	// Wake up one of the idle rings
+	hogl::post(idle[nidle / 2], a, hogl::area::INFO, "not so idle");
+
+	for (unsigned int i = 0; i < 100 && eng.get_stats().recs_out < s0.recs_out + nrecs + 1; i++)
+		usleep(10000);
+
+	hogl::engine::stats s1 = eng.get_stats();
+
+	BOOST_REQUIRE(s1.recs_out == s0.recs_out + nrecs + 1);
+	BOOST_REQUIRE(s1.recs_dropped == 0);
+
+	// Idle rings are visited only during the periodic full passes
+	unsigned long loops   = s1.loops - s0.loops;
+	unsigned long visited = s1.rings_visited - s0.rings_visited;
+	std::cout << "loops " << loops << " rings visited " << visited << std::endl;
+	BOOST_REQUIRE(visited < loops * (nidle + 1) / 4);
+
+	for (unsigned int i = 0; i < nidle; i++)
+		idle[i]->release();
+	busy->release();
+
+	std::cout << eng.get_stats();
+}
+
+// Format that remembers where the records from a specific area ended up
+class order_format : public hogl::format {
+public:
+	const hogl::area *watch;
+	unsigned long     count;
+	unsigned long     pos;
+
+	order_format() : watch(0), count(0), pos(0) { }
+
+	void process(hogl::ostrbuf &, const hogl::format::data &d)
+	{
+		count++;
+		if (d.record->area == watch && !pos)
+			pos = count;
+	}
+};
+
+static void test_ring_budget(unsigned int features)
+{
+	order_format       format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.features = features;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *flood_area = eng.add_area("FLOOD");
+	const hogl::area *err_area   = eng.add_area("ERR");
+	format.watch = err_area;
+
+	// Low priority ring with a small budget and a high priority one
+	hogl::ringbuf::options fopts = { .capacity = 16384, .prio = 0, .flags = 0, .record_tailroom = 0, .budget = 32 };
+	hogl::ringbuf::options eopts = { .capacity = 64, .prio = 100, .flags = 0, .record_tailroom = 0 };
+
+	// Fill the rings before handing them to the engine
+	hogl::ringbuf *flood = (new hogl::ringbuf("FLOOD", fopts))->hold();
+	hogl::ringbuf *err   = (new hogl::ringbuf("ERR", eopts))->hold();
+
+	const unsigned int nrecs = 10000;
+	for (unsigned int i = 0; i < nrecs; i++)
+		hogl::post(flood, flood_area, hogl::area::INFO, "flood %u", i);
+	hogl::post(err, err_area, hogl::area::ERROR, "error");
+
+	BOOST_REQUIRE(eng.add_ring(flood));
+	BOOST_REQUIRE(eng.add_ring(err));
+
+	for (unsigned int i = 0; i < 500 && eng.get_stats().recs_out < nrecs + 1; i++)
+		usleep(10000);
+
+	flood->release();
+	err->release();
+
+	const hogl::engine::stats &st = eng.get_stats();
+	std::cout << "error record at " << format.pos << " of " << format.count << std::endl;
+	std::cout << st;
+
+	BOOST_REQUIRE(st.recs_out == nrecs + 1);
+	BOOST_REQUIRE(st.recs_dropped == 0);
+	BOOST_REQUIRE(st.rings_throttled > 0);
+
+	// Error record must not wait for the flood to drain
+	BOOST_REQUIRE(format.pos != 0 && format.pos < nrecs / 2);
+}
+
+BOOST_AUTO_TEST_CASE(ring_budget)
+{
+	test_ring_budget(0);
+	test_ring_budget(hogl::engine::DISABLE_TSO);
+}
+
+// Checks that record timestamps match the realtime clock sampled
+// right before the record was posted.
+class skew_format : public hogl::format {
+public:
+	const hogl::area *watch;
+	unsigned long     count;
+	int64_t           max_skew;
+
+	skew_format() : watch(0), count(0), max_skew(0) { }
+
+	void process(hogl::ostrbuf &, const hogl::format::data &d)
+	{
+		if (d.record->area != watch)
+			return;
+		int64_t skew = (int64_t) (d.nsec().to_nsec() - d.record->argval[1].u64);
+		if (skew < 0) skew = -skew;
+		if (skew > max_skew) max_skew = skew;
+		count++;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(tsc_timesource)
+{
+	skew_format       format;
+	hogl::output_null output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.timesource = &hogl::tsc_timesource;
+
+	hogl::engine eng(output, opts);
+
+	// Second engine calibrates the same timesource
+	hogl::format_basic format2;
+	hogl::output_null  output2(format2);
+	hogl::engine eng2(output2, opts);
+
+	format.watch = eng.add_area("TSC");
+
+	hogl::ringbuf::options ropts = { .capacity = 1024, .prio = 0, .flags = 0, .record_tailroom = 0 };
+	hogl::ringbuf *ring = eng.add_ring("TSC", ropts);
+
+	// Long enough to go through a recalibration
+	const unsigned int nrecs = 150;
+	for (unsigned int i = 0; i < nrecs; i++) {
+		hogl::post(ring, format.watch, hogl::area::INFO, "realtime %llu",
+				hogl::realtime_timesource.timestamp().to_nsec());
+		usleep(10000);
+	}
+
+	ring->release();
+
+	for (unsigned int i = 0; i < 500 && format.count < nrecs; i++)
+		usleep(10000);
+
+	std::cout << "tsc raw " << hogl::tsc_timesource.raw() << " max skew " << format.max_skew << " nsec" << std::endl;
+
+	BOOST_REQUIRE(format.count == nrecs);
+	BOOST_REQUIRE(format.max_skew < 1000000);
+}
+
+static void test_ring_block(unsigned int features)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	// Long polling interval. Blocked writer must not wait for it.
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.polling_interval_usec = 100000;
+	opts.features = features;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("BLOCK");
+
+	hogl::ringbuf::options ropts = { .capacity = 64, .prio = 0, .flags = hogl::ringbuf::BLOCKING, .record_tailroom = 0 };
+	hogl::ringbuf *ring = eng.add_ring("BLOCK", ropts);
+
+	const unsigned int nrecs = 20000;
+
+	struct timeval start, end;
+	gettimeofday(&start, 0);
+
+	for (unsigned int i = 0; i < nrecs; i++)
+		hogl::post(ring, a, hogl::area::INFO, "block %u", i);
+
+	gettimeofday(&end, 0);
+
+	ring->release();
+
+	for (unsigned int i = 0; i < 500 && eng.get_stats().recs_out < nrecs; i++)
+		usleep(10000);
+
+	unsigned long msec = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+
+	const hogl::engine::stats &st = eng.get_stats();
+	std::cout << "posted " << nrecs << " records into blocking ring in " << msec << " msec" << std::endl;
+	std::cout << st;
+
+	BOOST_REQUIRE(st.recs_out == nrecs);
+	BOOST_REQUIRE(st.recs_dropped == 0);
+
+	// Ring fills up about nrecs / 64 times. Waiting for the polling
+	// interval each time would take tens of seconds.
+	BOOST_REQUIRE(msec < 5000);
+}
+
+BOOST_AUTO_TEST_CASE(ring_block)
+{
+	test_ring_block(0);
+	test_ring_block(hogl::engine::DISABLE_TSO);
+}
+
+static void test_flush_latency(unsigned int features)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	// Long polling interval. Flush must not wait for it.
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.polling_interval_usec = 100000;
+	opts.features = features;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *a = eng.add_area("FLUSH");
+
+	hogl::ringbuf::options ropts = { .capacity = 1024, .prio = 0, .flags = 0, .record_tailroom = 0 };
+	hogl::ringbuf *ring = eng.add_ring("FLUSH", ropts);
+
+	// Let the engine pick up the ring
+	usleep(200000);
+
+	const unsigned int nflush = 20;
+	unsigned int failed = 0;
+
+	struct timeval start, end;
+	gettimeofday(&start, 0);
+
+	for (unsigned int i = 0; i < nflush; i++) {
+		hogl::post(ring, a, hogl::area::INFO, "flush %u", i);
+		if (!hogl::flush(ring, 10000000))
+			failed++;
+	}
+
+	gettimeofday(&end, 0);
+
+	unsigned long recs_out = eng.get_stats().recs_out;
+
+	ring->release();
+
+	unsigned long msec = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+	std::cout << nflush << " flushes in " << msec << " msec" << std::endl;
+
+	BOOST_REQUIRE(failed == 0);
+
+	// Posted records and flush records are out by the time flush returns
+	BOOST_REQUIRE(recs_out == nflush * 2);
+
+	// Waiting for the polling interval would take seconds
+	BOOST_REQUIRE(msec < 1000);
+}
+
+BOOST_AUTO_TEST_CASE(flush_latency)
+{
+	test_flush_latency(0);
+	test_flush_latency(hogl::engine::DISABLE_TSO);
+}
+
+// Counts the records that came out of a specific ring
+class recorder_format : public hogl::format {
+public:
+	const char   *ring;
+	unsigned long count;
+	unsigned long last;
+
+	recorder_format() : ring(0), count(0), last(0) { }
+
+	void process(hogl::ostrbuf &, const hogl::format::data &d)
+	{
+		if (!ring || strcmp(d.ring_name, ring))
+			return;
+		count++;
+		last = d.record->argval[1].u32;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(flight_recorder)
+{
+	recorder_format    format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.recorder_depth = 100;
+
+	hogl::engine eng(output, opts);
+
+	const hogl::area *area = eng.add_area("FR");
+	format.ring = "FR.REC";
+
+	hogl::ringbuf::options ropts = { .capacity = 1024, .prio = 0, .flags = 0, .record_tailroom = 0 };
+	hogl::ringbuf *ring = eng.add_ring("FR", ropts);
+	bool added = eng.add_recorder(ring, hogl::mask("FR:DEBUG", 0), ropts);
+	bool again = eng.add_recorder(ring, hogl::mask("FR:DEBUG", 0), ropts);
+
+	// Debug records go into the recorder and stay there
+	const unsigned int nrecs = 5000;
+	for (unsigned int i = 0; i < nrecs; i++)
+		hogl::post(ring, area, hogl::area::DEBUG, "debug %u", i);
+	hogl::post(ring, area, hogl::area::INFO, "info");
+
+	for (unsigned int i = 0; i < 500 && eng.get_stats().recs_out < 1; i++)
+		usleep(10000);
+	usleep(50000);
+	unsigned long quiet = format.count;
+
+	// Error fires the dump
+	hogl::post(ring, area, hogl::area::ERROR, "error");
+	for (unsigned int i = 0; i < 500 && eng.get_stats().recorder_dumps < 1; i++)
+		usleep(10000);
+	unsigned long dumped = format.count, last = format.last;
+
+	// So does an explicit request
+	eng.dump_recorders();
+	for (unsigned int i = 0; i < 500 && eng.get_stats().recorder_dumps < 2; i++)
+		usleep(10000);
+
+	ring->release();
+
+	std::cout << "recorder dumped " << dumped << " record(s), last " << last << std::endl;
+	std::cout << eng.get_stats();
+
+	BOOST_REQUIRE(added && !again);
+	BOOST_REQUIRE(quiet == 0);
+	BOOST_REQUIRE(dumped == 100);
+	BOOST_REQUIRE(last == nrecs - 1);
+	BOOST_REQUIRE(format.count == 200);
+	BOOST_REQUIRE(eng.get_stats().recs_dropped == 0);
+}
+
+struct percpu_args {
+	hogl::engine     *eng;
+	hogl::percpu     *rings;
+	const hogl::area *area;
+	unsigned int      nrecs;
+};
+
+static void *percpu_thread(void *arg)
+{
+	percpu_args *a = (percpu_args *) arg;
+	hogl::tls tls(*a->rings, a->eng);
+
+	for (unsigned int i = 0; i < a->nrecs; i++)
+		hogl::post(a->area, hogl::area::INFO, "percpu record %u", i);
+	hogl::flush();
+	return 0;
+}
+
+// Counts the records that reference the original buffer
+class borrow_format : public hogl::format {
+public:
+	const uint8_t *buf;
+	unsigned long  count;
+
+	borrow_format(const uint8_t *b) : buf(b), count(0) { }
+
+	void process(hogl::ostrbuf &, const hogl::format::data &d)
+	{
+		unsigned int len;
+		if (d.record->get_arg_type(1) == hogl::arg::RAW && d.record->get_arg_data(1, len) == buf)
+			count++;
+	}
+};
+
+static void borrow_release(const void *, void *ctx)
+{
+	__sync_fetch_and_add((unsigned int *) ctx, 1);
+}
+
+BOOST_AUTO_TEST_CASE(borrowed_data)
+{
+	static uint8_t buf[16384];
+
+	borrow_format     format(buf);
+	hogl::output_null output(format);
+	hogl::engine eng(output);
+
+	const hogl::area *area = eng.add_area("BORROW");
+
+	hogl::ringbuf::options ropts = { .capacity = 256, .prio = 0, .flags = hogl::ringbuf::BLOCKING, .record_tailroom = 128 };
+	hogl::ringbuf *ring = eng.add_ring("BORROW", ropts);
+
+	// Data is formatted straight from the buffer and released after that
+	unsigned int released = 0;
+	const unsigned int nrecs = 1000;
+	for (unsigned int i = 0; i < nrecs; i++)
+		hogl::post(ring, area, hogl::area::INFO, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+
+	bool flushed = hogl::flush(ring);
+	ring->release();
+
+	std::cout << eng.get_stats();
+
+	BOOST_REQUIRE(flushed);
+	BOOST_REQUIRE(format.count == nrecs);
+	BOOST_REQUIRE(released == nrecs);
+}
+
+BOOST_AUTO_TEST_CASE(percpu_rings)
+{
+	hogl::format_basic format("timestamp|ring|seqnum|area|section");
+	hogl::output_null  output(format);
+	hogl::engine eng(output);
+
+	hogl::ringbuf::options ropts = { .capacity = 4096, .prio = 0, .flags = hogl::ringbuf::BLOCKING, .record_tailroom = 64 };
+	hogl::percpu *rings = new hogl::percpu("PCPU", ropts, &eng);
+	BOOST_REQUIRE(rings->valid());
+
+	// Lots of threads, a handful of rings
+	const unsigned int nthreads = 64;
+	percpu_args args = { &eng, rings, eng.add_area("PCPU"), 1000 };
+
+	pthread_t tid[nthreads];
+	for (unsigned int i = 0; i < nthreads; i++)
+		pthread_create(&tid[i], NULL, percpu_thread, &args);
+	for (unsigned int i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+
+	hogl::string_list l;
+	eng.list_rings(l);
+
+	unsigned int nrings = rings->count();
+	delete rings;
+
+	std::cout << "percpu rings " << nrings << " total rings " << l.size() << std::endl;
+	std::cout << eng.get_stats();
+
+	BOOST_REQUIRE(nrings > 0);
+	BOOST_REQUIRE(l.size() == nrings);
+	BOOST_REQUIRE(eng.get_stats().recs_out >= nthreads * args.nrecs);
+	BOOST_REQUIRE(eng.get_stats().recs_dropped == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ring_memory_limit)
+{
+	hogl::format_basic format;
+	hogl::output_null  output(format);
+
+	hogl::engine::options opts = hogl::engine::default_options;
+	opts.ring_memory_limit = 4 * 1024 * 1024 + 512 * 1024;
+
+	hogl::engine eng(output, opts);
+
+	hogl::ringbuf::options sopts = { .capacity = 4096, .prio = 0, .flags = hogl::ringbuf::SHARED, .record_tailroom = 128 };
+	hogl::ringbuf *shared = eng.add_ring("MEM-SHARED", sopts);
+	BOOST_REQUIRE(shared != 0);
+
+	// Keep allocating until the rings no longer fit
+	hogl::ringbuf::options ropts = { .capacity = 4096, .prio = 0, .flags = 0, .record_tailroom = 128 };
+	std::vector<hogl::ringbuf *> rings;
+	for (unsigned int i = 0; i < 1000; i++) {
+		char name[32];
+		sprintf(name, "MEM-%u", i);
+		hogl::ringbuf *r = eng.add_ring(name, ropts);
+		if (!r)
+			break;
+		rings.push_back(r);
+	}
+
+	// Existing shared ring is reused without allocating anything
+	unsigned long shrunk = eng.get_stats().rings_shrunk;
+	hogl::ringbuf *again = eng.add_ring("MEM-SHARED", sopts);
+	BOOST_REQUIRE(again == shared);
+	BOOST_REQUIRE(eng.get_stats().rings_shrunk == shrunk);
+	again->release();
+	shared->release();
+
+	unsigned int smallest = ropts.capacity;
+	for (unsigned int i = 0; i < rings.size(); i++) {
+		if (rings[i]->capacity() < smallest)
+			smallest = rings[i]->capacity();
+		rings[i]->release();
+	}
+
+	hogl::engine::stats st = eng.get_stats();
+	std::cout << "allocated " << rings.size() << " rings, smallest capacity " << smallest << std::endl;
+	std::cout << st;
+
+	BOOST_REQUIRE(rings.size() > 1);
+	BOOST_REQUIRE(smallest < ropts.capacity && smallest >= hogl::engine::MIN_RING_CAPACITY);
+	BOOST_REQUIRE(st.rings_shrunk > 0);
+	BOOST_REQUIRE(st.rings_denied == 1);
+	BOOST_REQUIRE(st.ring_memory <= opts.ring_memory_limit);
+	BOOST_REQUIRE(st.ring_memory_used <= st.ring_memory);
+}
@@ -32,6 +32,9 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <sys/time.h>
+#include <ctype.h>
+
+#include <new>
 
 #include "hogl/detail/ostrbuf-null.hpp"
 #include "hogl/format-basic.hpp"
@@ -90,3 +93,256 @@ BOOST_AUTO_TEST_CASE(tscache)
 		}
 	}
 }
+
+// Test to make sure dtcache matches localtime_r() + printf() output,
+// including DST transitions and timezone changes.
+static void check_dtcache(hogl::format_basic::dtcache &dtcache, uint64_t begin, uint64_t end, uint64_t step)
+{
+	hogl::ostrbuf_null rsb(128);
+
+	for (uint64_t i = begin; i < end; i += step) {
+		hogl::timestamp t = i;
+
+		dtcache.update(t);
+
+		struct timespec ts;
+		t.to_timespec(ts);
+
+		struct tm tm;
+		localtime_r(&ts.tv_sec, &tm);
+
+		rsb.reset();
+		rsb.printf("%02u%02u%04u %02u:%02u:%02u.%09u",
+			(tm.tm_mon + 1), tm.tm_mday, (1900 + tm.tm_year),
+			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
+		rsb.push_back('\0');
+
+		BOOST_REQUIRE_MESSAGE(memcmp(dtcache.str(), rsb.head(), dtcache.len()) == 0,
+			"[" << std::string(dtcache.str(), dtcache.len()) << "] vs [" << (const char *) rsb.head() << "]" );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(dtcache)
+{
+	hogl::format_basic::dtcache dtcache;
+
+	const uint64_t nsec_per_sec = 1000000000ULL;
+
+	// US Eastern with DST rules (POSIX format, no tzdata needed)
+	setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+	tzset();
+
+	// Sub-second steps
+	check_dtcache(dtcache, 0, 3 * nsec_per_sec, 999983);
+
+	// Around the DST switch on 2020-03-08 07:00 UTC
+	uint64_t dst = 1583650800ULL * nsec_per_sec;
+	check_dtcache(dtcache, dst - 10 * nsec_per_sec, dst + 10 * nsec_per_sec, nsec_per_sec / 3);
+
+	// Change timezone and make sure the cache picks it up
+	setenv("TZ", "UTC0", 1);
+	check_dtcache(dtcache, dst + 10 * nsec_per_sec, dst + 12 * nsec_per_sec, nsec_per_sec / 7);
+
+	// Large timestamps
+	check_dtcache(dtcache, ~0ULL - 3 * nsec_per_sec, ~0ULL - nsec_per_sec, 12345677);
+
+	unsetenv("TZ");
+	tzset();
+}
+
+// String buffer that keeps all the output
+class ostrbuf_str : public hogl::ostrbuf {
+private:
+	void do_flush(const uint8_t *data, size_t n)
+	{
+		_str.append((const char *) _data, _size);
+		_str.append((const char *) data, n);
+		reset();
+	}
+
+	std::string _str;
+
+public:
+	ostrbuf_str() : hogl::ostrbuf(256) {}
+
+	const std::string& str() { flush(); return _str; }
+};
+
+// Reference xdump renderers (printf based)
+static void ref_hexdump(hogl::ostrbuf &sb, const uint8_t *data, unsigned int n, unsigned int lw)
+{
+	if (!lw) lw = n;
+	for (unsigned int offset = 0; offset < n; offset += lw) {
+		sb.printf("\n\t%03d: ", offset);
+		unsigned int i;
+		for (i = 0; i < lw; i++) {
+			if ((i + offset) < n)
+				sb.printf("%02x ", data[offset + i]);
+			else
+				sb.push_back("   ");
+		}
+		sb.push_back("  ");
+		for (i = 0; i < lw && ((i + offset) < n); i++) {
+			uint8_t b = data[offset + i];
+			sb.push_back(isprint(b) ? b : '.');
+		}
+	}
+	sb.push_back('\n');
+}
+
+template <typename T>
+static void ref_xdump(hogl::ostrbuf &sb, const T *data, unsigned int n, unsigned int lw, char delim)
+{
+	for (unsigned int i = 0; i < n;) {
+		if (lw)
+			sb.push_back("\n\t");
+		sb.printf("%llx", (unsigned long long) data[i++]);
+		for (unsigned int w = 1; i < n && (!lw || w < lw); w++) {
+			sb.push_back(delim);
+			sb.printf("%llx", (unsigned long long) data[i++]);
+		}
+	}
+	sb.push_back('\n');
+}
+
+static std::string format_xdump(const hogl::arg_xdump &xd)
+{
+	static hogl::area area("XDUMP");
+
+	alignas(64) static uint8_t buf[sizeof(hogl::record) + 8192];
+
+	hogl::record &r = *new (buf) hogl::record();
+	r.area = &area;
+	r.set_args(sizeof(buf) - hogl::record::header_size(), xd);
+
+	hogl::format_basic fmt((uint32_t) 0);
+	hogl::format::data d = {};
+	d.ring_name = "RING";
+	d.record = &r;
+
+	ostrbuf_str sb;
+	fmt.process(sb, d);
+	return sb.str();
+}
+
+// Make sure vectorized xdump rendering matches printf()
+BOOST_AUTO_TEST_CASE(xdump)
+{
+	uint8_t data[1024];
+	for (unsigned int i = 0; i < sizeof(data); i++)
+		data[i] = (i * 7) ^ (i >> 3);
+
+	unsigned int len[] = { 1, 15, 16, 17, 31, 32, 33, 64, 100, 1024 };
+	unsigned int lw[]  = { 0, 1, 8, 16, 20, 32, 40, 255 };
+
+	for (unsigned int l : len) {
+		for (unsigned int w : lw) {
+			ostrbuf_str ref;
+
+			ref_hexdump(ref, data, l, w);
+			BOOST_REQUIRE_MESSAGE(format_xdump(hogl::arg_xdump(data, l, 'H', 1, 0, w)) == ref.str(),
+				"hexdump len " << l << " line-width " << w);
+
+			ostrbuf_str ref8;
+			ref_xdump(ref8, data, l, w, ',');
+			BOOST_REQUIRE_MESSAGE(format_xdump(hogl::arg_xdump(data, l, 'x', 1, 0, w, ',')) == ref8.str(),
+				"xdump8 len " << l << " line-width " << w);
+
+			ostrbuf_str ref16;
+			ref_xdump(ref16, (const uint16_t *) data, l / 2, w, ' ');
+			BOOST_REQUIRE_MESSAGE(format_xdump(hogl::arg_xdump(data, l & ~1U, 'x', 2, 0, w, ' ')) == ref16.str(),
+				"xdump16 len " << l << " line-width " << w);
+
+			ostrbuf_str ref64;
+			ref_xdump(ref64, (const uint64_t *) data, l / 8, w, ':');
+			BOOST_REQUIRE_MESSAGE(format_xdump(hogl::arg_xdump(data, l & ~7U, 'x', 8, 0, w, ':')) == ref64.str(),
+				"xdump64 len " << l << " line-width " << w);
+		}
+	}
+}
+
+// Reference header renderer (printf based)
+static void ref_header(hogl::ostrbuf &sb, uint32_t fields, const hogl::record &r,
+		hogl::timestamp &last, const char *ring_name)
+{
+	typedef hogl::format_basic fb;
+
+	struct timespec ts;
+	r.timestamp.to_timespec(ts);
+
+	if (fields & fb::TIMESPEC)
+		sb.printf("%011lu.%09lu ", ts.tv_sec, ts.tv_nsec);
+
+	if (fields & fb::TIMESTAMP) {
+		struct tm tm;
+		localtime_r(&ts.tv_sec, &tm);
+		sb.printf("%02u%02u%04u %02u:%02u:%02u.%09u ",
+			(tm.tm_mon + 1), tm.tm_mday, (1900 + tm.tm_year),
+			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
+	}
+
+	if (fields & fb::TIMEDELTA) {
+		hogl::timestamp delta = r.timestamp - last;
+		if (last == hogl::timestamp(0))
+			delta = 0;
+		sb.printf("(%llu) ", (unsigned long long) delta.to_nsec());
+		last = r.timestamp;
+	}
+
+	const char *area_name = r.area->name();
+	const char *sect_name = r.area->section_name(r.section);
+	unsigned long seqnum  = r.seqnum;
+
+	switch (fields & (fb::RING | fb::SEQNUM)) {
+	case (fb::RING | fb::SEQNUM): sb.printf("%s:%lu ", ring_name, seqnum); break;
+	case fb::RING:                sb.printf("%s ", ring_name); break;
+	case fb::SEQNUM:              sb.printf("%lu ", seqnum); break;
+	}
+
+	switch (fields & (fb::AREA | fb::SECTION)) {
+	case (fb::AREA | fb::SECTION): sb.printf("%s:%s ", area_name, sect_name); break;
+	case fb::AREA:                 sb.printf("%s ", area_name); break;
+	case fb::SECTION:              sb.printf("%s ", sect_name); break;
+	}
+}
+
+// Make sure generated header formatters match printf() for all combinations of fields
+BOOST_AUTO_TEST_CASE(headers)
+{
+	static const char *sections[] = { "SECT0", "SECTION-ONE", 0 };
+	static hogl::area area("HEADERS", sections);
+
+	alignas(64) static uint8_t buf[sizeof(hogl::record) + 256];
+
+	hogl::record &r = *new (buf) hogl::record();
+	r.area = &area;
+	r.section = 1;
+	r.set_args(sizeof(buf) - hogl::record::header_size(), hogl::arg_gstr("message"));
+
+	uint64_t tsval[] = { 1583650799999999999ULL, 1583650800000000001ULL, 1583650800000012345ULL, 1999999999999999999ULL };
+
+	for (uint32_t f = 0; f <= 0x7f; f++) {
+		hogl::format_basic fmt(f);
+		hogl::format_basic body((uint32_t) 0);
+		hogl::timestamp last(0);
+
+		for (unsigned int i = 0; i < sizeof(tsval)/sizeof(tsval[0]); i++) {
+			r.timestamp = tsval[i];
+			r.seqnum = i * 999999937ULL;
+
+			hogl::format::data d = {};
+			d.ring_name = "RING-0";
+			d.record = &r;
+
+			ostrbuf_str out;
+			fmt.process(out, d);
+
+			ostrbuf_str ref;
+			ref_header(ref, f, r, last, d.ring_name);
+			body.process(ref, d);
+
+			BOOST_REQUIRE_MESSAGE(out.str() == ref.str(),
+				"fields " << f << ": [" << out.str() << "] vs [" << ref.str() << "]");
+		}
+	}
+}
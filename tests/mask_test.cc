@@ -35,6 +35,15 @@
 
 #include "hogl/detail/area.hpp"
 #include "hogl/detail/mask.hpp"
+#include "hogl/detail/limiter.hpp"
+#include "hogl/detail/overlay.hpp"
+#include "hogl/detail/ringbuf.hpp"
+#include "hogl/post.hpp"
+
+#include <regex>
+#include <vector>
+#include <memory>
+#include <chrono>
 
 #define BOOST_TEST_MODULE mask_test 
 #include <boost/test/included/unit_test.hpp>
@@ -161,3 +170,277 @@ BOOST_AUTO_TEST_CASE(twice)
 	hogl::mask m1("XYZ:DEBUG", "!HOGL:.*DEBUG", NULL);
 	hogl::mask m2("XYZ:DEBUG", "ABC:DEBUG", "SOME_AREA:DEBUG", "OTHER:DEBUG", "!.*:DEBUG", "");
 }
+
+BOOST_AUTO_TEST_CASE(limits)
+{
+	hogl::area area("DEF", sect_names);
+
+	hogl::mask mask;
+	mask << ".*:.*" << "DEF:DEBUG@1000/s" << "DEF:EXTRA:DEBUG@1/10" << ".*:EXTRA:INFO@1/4,50/s";
+	mask << "DEF:ERROR@bogus";
+	mask.apply(area);
+
+	std::cout << mask;
+
+	for (unsigned int i=0; i < area.size(); i++)
+		BOOST_REQUIRE(area.test(i) == true);
+
+	BOOST_REQUIRE(area.limited(DEBUG));
+	BOOST_REQUIRE(area.get_limit(DEBUG).rate == 1000);
+	BOOST_REQUIRE(area.get_limit(DEBUG).sample == 0);
+
+	BOOST_REQUIRE(area.limited(EXTRA_DEBUG));
+	BOOST_REQUIRE(area.get_limit(EXTRA_DEBUG).rate == 0);
+	BOOST_REQUIRE(area.get_limit(EXTRA_DEBUG).sample == 10);
+
+	BOOST_REQUIRE(area.limited(EXTRA_INFO));
+	BOOST_REQUIRE(area.get_limit(EXTRA_INFO).rate == 50);
+	BOOST_REQUIRE(area.get_limit(EXTRA_INFO).sample == 4);
+
+	BOOST_REQUIRE(!area.limited(INFO));
+	BOOST_REQUIRE(!area.limited(ERROR));
+
+	// Later entries override limits
+	mask << "!DEF:DEBUG" << "DEF:EXTRA:DEBUG";
+	mask.apply(area);
+	BOOST_REQUIRE(!area.test(DEBUG));
+	BOOST_REQUIRE(!area.limited(DEBUG));
+	BOOST_REQUIRE(!area.limited(EXTRA_DEBUG));
+}
+
+BOOST_AUTO_TEST_CASE(limiter)
+{
+	hogl::area area("DEF", sect_names);
+
+	hogl::area::limit rate = { 100, 0 };
+	hogl::area::limit sample = { 0, 8 };
+	area.set_limit(DEBUG, rate);
+	area.set_limit(INFO, sample);
+
+	hogl::limiter l;
+	uint64_t t = 1000000000;
+	unsigned int i, n;
+
+	// Token bucket starts full, 100 records per second
+	for (i=0, n=0; i < 1000; i++)
+		n += l.admit(&area, DEBUG, hogl::timestamp(t));
+	BOOST_REQUIRE(n == 100);
+
+	// Half a second later 50 more are allowed
+	t += 500000000;
+	for (i=0, n=0; i < 1000; i++)
+		n += l.admit(&area, DEBUG, hogl::timestamp(t));
+	BOOST_REQUIRE(n == 50);
+
+	// One in 8 records is sampled
+	for (i=0, n=0; i < 800; i++)
+		n += l.admit(&area, INFO, hogl::timestamp(t));
+	BOOST_REQUIRE(n == 100);
+
+	// Unlimited sections are not tracked
+	for (i=0, n=0; i < 100; i++)
+		n += l.admit(&area, ERROR, hogl::timestamp(t));
+	BOOST_REQUIRE(n == 100);
+
+	// Collect suppressed counters
+	uint64_t total = 0;
+	for (i=0; i < hogl::limiter::CAPACITY; i++) {
+		const hogl::area *a;
+		unsigned int s;
+		uint64_t c = l.take_suppressed(i, a, s);
+		if (!c)
+			continue;
+		BOOST_REQUIRE(a == &area);
+		BOOST_REQUIRE(s == DEBUG || s == INFO);
+		total += c;
+	}
+	BOOST_REQUIRE(total == (900 + 950 + 700));
+
+	for (i=0; i < hogl::limiter::CAPACITY; i++) {
+		const hogl::area *a;
+		unsigned int s;
+		BOOST_REQUIRE(l.take_suppressed(i, a, s) == 0);
+	}
+}
+
+// Reference mask implementation (std::regex for every area and section)
+struct ref_mask {
+	struct rule { std::regex area; std::regex sect; bool on; };
+	std::vector<rule> rules;
+
+	void add(const std::string &str)
+	{
+		bool on = (str[0] != '!');
+		size_t abeg = !on;
+		size_t aend = str.find(':', abeg);
+		std::string areg = str.substr(abeg, aend - abeg);
+		std::string sreg = str.substr(aend + 1);
+		if (areg.empty()) areg = ".*";
+		if (sreg.empty()) sreg = ".*";
+		rule r = { std::regex(areg, std::regex::extended), std::regex(sreg, std::regex::extended), on };
+		rules.push_back(r);
+	}
+
+	void apply(hogl::area &area) const
+	{
+		for (unsigned int r = 0; r < rules.size(); r++) {
+			if (!std::regex_match(std::string(area.name()), rules[r].area))
+				continue;
+			for (unsigned int i = 0; i < area.size(); i++)
+				if (std::regex_match(std::string(area.section_name(i)), rules[r].sect))
+					area.set(i, rules[r].on);
+		}
+	}
+};
+
+static const char *bench_rules[] = {
+	".*:(INFO|WARN|ERROR|FATAL).*",
+	"!NET.*:DEBUG",
+	"NET0:.*",
+	".*:.*TRACE",
+	"DISK.*:(DEBUG|TRACE)",
+	"!.*1:.*",
+	"^CPU7$:EXTRA:.*",
+	"MEM\\.X:INFO",
+	"NET[0-9]+:EXTRA:.*",
+	"DISK3:DEB.G",
+	"(NET|DISK)2:(INFO|)",
+	"!CPU.*:INFO",
+	".*5.*:EXTRA:ERROR",
+	"IO|CPU3:ERROR",
+	"NET.*:EXTRA:(DEBUG|INFO)",
+	"!DISK.*:EXTRA:.*",
+	"CPU.*:(WARN|ERROR)",
+	".*:[A-Z]+:DEBUG",
+	"!.*9:.*",
+	"MEM.*:.*",
+	0
+};
+
+static const char *bench_sections[] = {
+	"INFO", "WARN", "ERROR", "FATAL", "DEBUG", "TRACE",
+	"EXTRA:INFO", "EXTRA:ERROR", "EXTRA:DEBUG", "EXTRA:TRACE", 0
+};
+
+// Make sure compiled mask matches std::regex, and measure mask application time.
+BOOST_AUTO_TEST_CASE(compiled)
+{
+	static const char *prefix[] = { "NET", "DISK", "CPU", "MEM", "IO" };
+	unsigned int nareas = 2000;
+
+	std::vector<std::unique_ptr<hogl::area> > areas, ref_areas;
+	for (unsigned int i = 0; i < nareas; i++) {
+		std::string name = std::string(prefix[i % 5]) + std::to_string(i / 5 % 10);
+		if (i >= 50) name += "_" + std::to_string(i);
+		areas.emplace_back(new hogl::area(name.c_str(), bench_sections));
+		ref_areas.emplace_back(new hogl::area(name.c_str(), bench_sections));
+	}
+
+	hogl::mask mask;
+	ref_mask ref;
+	for (unsigned int r = 0; bench_rules[r]; r++) {
+		mask << bench_rules[r];
+		ref.add(bench_rules[r]);
+	}
+
+	typedef std::chrono::steady_clock clock;
+
+	clock::time_point t0 = clock::now();
+	for (unsigned int i = 0; i < nareas; i++)
+		ref.apply(*ref_areas[i]);
+	clock::time_point t1 = clock::now();
+	for (unsigned int i = 0; i < nareas; i++)
+		mask.apply(*areas[i]);
+	clock::time_point t2 = clock::now();
+	for (unsigned int i = 0; i < nareas; i++)
+		mask.apply(*areas[i]);
+	clock::time_point t3 = clock::now();
+
+	for (unsigned int i = 0; i < nareas; i++) {
+		for (unsigned int s = 0; s < areas[i]->size(); s++)
+			BOOST_REQUIRE_MESSAGE(areas[i]->test(s) == ref_areas[i]->test(s),
+				"area " << areas[i]->name() << " section " << areas[i]->section_name(s));
+	}
+
+	typedef std::chrono::microseconds usec;
+	std::cout << "mask apply: areas " << nareas << " rules " << ref.rules.size()
+		<< " regex " << std::chrono::duration_cast<usec>(t1 - t0).count() << " usec"
+		<< " compiled " << std::chrono::duration_cast<usec>(t2 - t1).count() << " usec"
+		<< " cached " << std::chrono::duration_cast<usec>(t3 - t2).count() << " usec"
+		<< std::endl;
+}
+
+// More areas than the match cache holds
+BOOST_AUTO_TEST_CASE(cache_eviction)
+{
+	const unsigned int nareas = 5000;
+
+	std::vector<std::unique_ptr<hogl::area> > areas;
+	for (unsigned int i = 0; i < nareas; i++)
+		areas.emplace_back(new hogl::area(("AREA" + std::to_string(i)).c_str(), sect_names));
+
+	hogl::mask mask(".*:INFO", "AREA1.*:DEBUG", 0);
+	for (unsigned int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 0; i < nareas; i++) {
+			mask.apply(*areas[i]);
+			bool debug = std::to_string(i)[0] == '1';
+			BOOST_REQUIRE(areas[i]->test(INFO) == true);
+			BOOST_REQUIRE(areas[i]->test(DEBUG) == debug);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(overlay)
+{
+	hogl::area area("DEF", sect_names);
+	hogl::area other("OTHER", sect_names);
+	area.reset();
+	area.set(ERROR);
+	other.reset();
+
+	hogl::mask m;
+	m << "DEF:.*DEBUG" << "!DEF:EXTRA:DEBUG";
+
+	// Overlay never touches the areas
+	hogl::overlay o(m);
+	BOOST_REQUIRE(o.test(&area, DEBUG) == true);
+	BOOST_REQUIRE(o.test(&area, EXTRA_DEBUG) == false);
+	BOOST_REQUIRE(o.test(&area, INFO) == false);
+	BOOST_REQUIRE(o.test(&other, DEBUG) == false);
+	BOOST_REQUIRE(area.test(DEBUG) == false);
+
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+
+	hogl::ringbuf debug("DEBUG", opts);
+	hogl::ringbuf plain("PLAIN", opts);
+
+	debug.set_overlay(m);
+
+	// Sections enabled by the overlay only for the ring that has it
+	BOOST_REQUIRE(hogl::enabled(&debug, &area, DEBUG) == true);
+	BOOST_REQUIRE(hogl::enabled(&plain, &area, DEBUG) == false);
+	BOOST_REQUIRE(hogl::enabled(&debug, &area, INFO) == false);
+	BOOST_REQUIRE(hogl::enabled(&debug, &area, ERROR) == true);
+	BOOST_REQUIRE(hogl::enabled(&debug, &other, DEBUG) == false);
+
+	for (unsigned int i = 0; i < 10; i++) {
+		hogl::post_unlocked(&debug, &area, DEBUG, "debug %u", i);
+		hogl::post_unlocked(&plain, &area, DEBUG, "debug %u", i);
+	}
+	BOOST_REQUIRE(debug.size() == 10);
+	BOOST_REQUIRE(plain.size() == 0);
+
+	// Replaced overlays are freed once no writer can see them
+	for (unsigned int i = 0; i < 10; i++)
+		debug.set_overlay(m);
+	BOOST_REQUIRE(hogl::enabled(&debug, &area, DEBUG) == true);
+	debug.reclaim_overlays();
+	debug.reclaim_overlays();
+	BOOST_REQUIRE(debug.overlays_retired() == false);
+
+	debug.clear_overlay();
+	BOOST_REQUIRE(hogl::enabled(&debug, &area, DEBUG) == false);
+
+	debug.reset();
+}
@@ -36,7 +36,12 @@
 #include "hogl/detail/ringbuf.hpp"
 #include "hogl/engine.hpp"
 #include "hogl/timesource.hpp"
+#include "hogl/mask.hpp"
 #include "hogl/post.hpp"
+#include "hogl/batch.hpp"
+#include "hogl/detail/arena.hpp"
+
+#include <string>
 
 #define BOOST_TEST_MODULE ring_test 
 #include <boost/test/included/unit_test.hpp>
@@ -166,3 +171,295 @@ BOOST_AUTO_TEST_CASE(immortal_ring)
 	ring.hold();
 	ring.release();
 }
+
+static hogl::timestamp fixed_clock(const hogl::timesource *)
+{
+	return hogl::timestamp(12345);
+}
+
+BOOST_AUTO_TEST_CASE(ring_timestamp)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+
+	hogl::ringbuf ring("DUMMY", opts);
+
+	// Built-in clocks are read inline
+	ring.timesource(&hogl::realtime_timesource);
+	uint64_t t0 = hogl::realtime_timesource.timestamp().to_nsec();
+	uint64_t t1 = ring.timestamp().to_nsec();
+	BOOST_REQUIRE (t1 >= t0 && t1 - t0 < 1000000000);
+
+	ring.timesource(&hogl::monotonic_timesource);
+	t0 = hogl::monotonic_timesource.timestamp().to_nsec();
+	t1 = ring.timestamp().to_nsec();
+	BOOST_REQUIRE (t1 >= t0 && t1 - t0 < 1000000000);
+
+	ring.timesource(&hogl::monotonic_coarse_timesource);
+	t0 = hogl::monotonic_coarse_timesource.timestamp().to_nsec();
+	t1 = ring.timestamp().to_nsec();
+	BOOST_REQUIRE (t1 >= t0 && t1 - t0 < 1000000000);
+
+	// Custom ones go through the callback
+	hogl::timesource fixed("fixed", fixed_clock);
+	ring.timesource(&fixed);
+	BOOST_REQUIRE (ring.timestamp().to_nsec() == 12345);
+
+	ring.timesource(&hogl::default_timesource);
+}
+
+BOOST_AUTO_TEST_CASE(ring_reserve)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+	opts.reserve  = 8;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	BOOST_REQUIRE (ring.reserve() == 8);
+
+	hogl::area area("RESERVE");
+	hogl::mask mask(".*", "ERROR@critical", 0);
+	mask.apply(area);
+	BOOST_REQUIRE (area.critical(hogl::area::ERROR) == true);
+	BOOST_REQUIRE (area.critical(hogl::area::DEBUG) == false);
+
+	// Normal records stop short of the reserved room
+	for (unsigned int i = 0; i < 100; i++)
+		hogl::push(&ring, &area, hogl::area::DEBUG, "debug #%u", i);
+	BOOST_REQUIRE (ring.size() == 63 - 8);
+	BOOST_REQUIRE (ring.dropcnt() == 100 - (63 - 8));
+
+	// Critical records use it
+	for (unsigned int i = 0; i < 10; i++)
+		hogl::push(&ring, &area, hogl::area::ERROR, "error #%u", i);
+	BOOST_REQUIRE (ring.size() == 63);
+	BOOST_REQUIRE (ring.dropcnt() == 100 - (63 - 8) + 2);
+
+	ring.reset();
+}
+
+BOOST_AUTO_TEST_CASE(ring_arena)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+	opts.record_tailroom = 128;
+	opts.arena_size = 8192;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	BOOST_REQUIRE (ring.arena() != 0);
+	BOOST_REQUIRE (ring.arena()->size() == 8192);
+
+	hogl::area area("ARENA");
+
+	std::string str(3000, 'x');
+	uint8_t raw[1000];
+	for (unsigned int i = 0; i < sizeof(raw); i++)
+		raw[i] = i;
+
+	// Two records fit into the arena, the third one is truncated
+	for (unsigned int n = 0; n < 2; n++) {
+		for (unsigned int i = 0; i < 3; i++)
+			hogl::push(&ring, &area, hogl::area::INFO, "%s", str.c_str(), hogl::arg_raw(raw, sizeof(raw)));
+		BOOST_REQUIRE (ring.size() == 3);
+
+		for (unsigned int i = 0; i < 3; i++) {
+			hogl::record *r = ring.pop_begin();
+			BOOST_REQUIRE (r != 0);
+
+			unsigned int len;
+			const uint8_t *data = r->get_arg_data(1, len);
+			if (i < 2) {
+				BOOST_REQUIRE (len == str.length());
+				BOOST_REQUIRE (!memcmp(data, str.c_str(), len + 1));
+			} else
+				BOOST_REQUIRE (len < ring.record_tailroom());
+
+			data = r->get_arg_data(2, len);
+			if (i < 2) {
+				BOOST_REQUIRE (len == sizeof(raw));
+				BOOST_REQUIRE (!memcmp(data, raw, len));
+			}
+			ring.pop_commit();
+		}
+
+		// Everything is released once the records are consumed
+		BOOST_REQUIRE (ring.arena()->used() == 0);
+	}
+
+	// Recorder rings do not get an arena
+	opts.flags = hogl::ringbuf::RECORDER;
+	hogl::ringbuf rec("RECORDER", opts);
+	BOOST_REQUIRE (rec.arena() == 0);
+}
+
+static void borrow_release(const void *, void *ctx)
+{
+	(*(unsigned int *) ctx)++;
+}
+
+BOOST_AUTO_TEST_CASE(ring_borrow)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 4;
+	opts.record_tailroom = 128;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	hogl::area area("BORROW");
+
+	uint8_t buf[4096];
+	unsigned int released = 0;
+
+	// Records reference the original buffer. Dropped ones let go of it right away.
+	for (unsigned int i = 0; i < 5; i++)
+		hogl::push(&ring, &area, hogl::area::INFO, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+	BOOST_REQUIRE (ring.size() == 3);
+	BOOST_REQUIRE (ring.borrows());
+	BOOST_REQUIRE (released == 2);
+
+	hogl::record *r = ring.pop_begin();
+	unsigned int len;
+	const uint8_t *data = r->get_arg_data(1, len);
+	BOOST_REQUIRE (r->get_arg_type(1) == hogl::arg::RAW);
+	BOOST_REQUIRE (data == buf && len == sizeof(buf));
+
+	// Data is released only once
+	r->release_borrowed();
+	r->release_borrowed();
+	BOOST_REQUIRE (released == 3);
+	ring.pop_commit();
+
+	// Reset releases the rest
+	ring.reset();
+	BOOST_REQUIRE (released == 5);
+
+	// Recorder rings copy the data
+	opts.flags = hogl::ringbuf::RECORDER;
+	hogl::ringbuf rec("RECORDER", opts);
+	hogl::push(&rec, &area, hogl::area::INFO, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+	BOOST_REQUIRE (released == 6);
+	BOOST_REQUIRE (!rec.borrows());
+
+	r = rec.pop_begin();
+	data = r->get_arg_data(1, len);
+	BOOST_REQUIRE (data != buf && len < sizeof(buf));
+	rec.pop_commit();
+}
+
+// Records that are not posted release the borrowed data too
+BOOST_AUTO_TEST_CASE(ring_borrow_skip)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+	opts.record_tailroom = 128;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	hogl::area area("BORROW");
+	hogl::mask mask(".*:INFO", ".*:TRACE@1/100", 0);
+	mask.apply(area);
+	BOOST_REQUIRE (!area.test(hogl::area::DEBUG));
+	BOOST_REQUIRE (area.limited(hogl::area::TRACE));
+
+	uint8_t buf[256];
+	unsigned int released = 0;
+
+	// Disabled section
+	for (unsigned int i = 0; i < 10; i++)
+		hogl::post(&ring, &area, hogl::area::DEBUG, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+	BOOST_REQUIRE (ring.size() == 0);
+	BOOST_REQUIRE (released == 10);
+
+	// Rate limited section
+	for (unsigned int i = 0; i < 100; i++)
+		hogl::post(&ring, &area, hogl::area::TRACE, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+	BOOST_REQUIRE (ring.size() == 1);
+	BOOST_REQUIRE (released == 10 + 99);
+
+	// Batch
+	{
+		hogl::batch b(&ring, 4);
+		for (unsigned int i = 0; i < 10; i++)
+			b.post(&area, hogl::area::DEBUG, "packet", hogl::arg_borrow(buf, sizeof(buf), borrow_release, &released));
+	}
+	BOOST_REQUIRE (released == 10 + 99 + 10);
+
+	ring.reset();
+	BOOST_REQUIRE (released == 10 + 99 + 10 + 1);
+}
+
+BOOST_AUTO_TEST_CASE(ring_batch)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 64;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	hogl::area area("BATCH");
+	area.set();
+
+	{
+		hogl::batch b(&ring, 8, true);
+		for (unsigned int i = 0; i < 100; i++)
+			b.post(&area, hogl::area::INFO, "batch #%u", i);
+	}
+
+	BOOST_REQUIRE (ring.size() == 63);
+	BOOST_REQUIRE (ring.dropcnt() == 100 - 63);
+
+	hogl::record *r = ring.pop_begin();
+	hogl::timestamp ts = r->timestamp;
+	for (unsigned int i = 0; i < 63; i++) {
+		r = ring.pop_begin();
+		BOOST_REQUIRE (r->seqnum == i);
+		BOOST_REQUIRE (r->timestamp == ts);
+		BOOST_REQUIRE (r->get_arg_val32(1) == i);
+		ring.pop_commit();
+	}
+	BOOST_REQUIRE (ring.empty() == true);
+}
+
+BOOST_AUTO_TEST_CASE(ring_batch_perf)
+{
+	hogl::ringbuf::options opts = { };
+	opts.capacity = 4096;
+
+	hogl::ringbuf ring("DUMMY", opts);
+	hogl::area area("BATCH");
+	area.set();
+
+	const unsigned int nrecs = 4096 - 64;
+	const unsigned int nloops = 200;
+	const unsigned int sizes[] = { 1, 8, 64 };
+
+	for (unsigned int bs : sizes) {
+		struct timeval start, end;
+		unsigned long usec = 0;
+
+		for (unsigned int l = 0; l < nloops; l++) {
+			gettimeofday(&start, 0);
+			for (unsigned int i = 0; i < nrecs; i += bs) {
+				hogl::batch b(&ring, bs, true);
+				for (unsigned int j = 0; j < bs; j++)
+					b.post(&area, hogl::area::INFO, "batch #%u", j, i);
+			}
+			gettimeofday(&end, 0);
+			usec += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+			BOOST_REQUIRE (ring.dropcnt() == 0);
+			ring.reset();
+		}
+
+		std::cout << "batch size " << bs << ": " << (usec * 1000.0) / (nrecs * nloops) << " nsec per record" << std::endl;
+	}
+
+	// Plain post for reference
+	struct timeval start, end;
+	unsigned long usec = 0;
+	for (unsigned int l = 0; l < nloops; l++) {
+		gettimeofday(&start, 0);
+		for (unsigned int i = 0; i < nrecs; i++)
+			hogl::post(&ring, &area, hogl::area::INFO, "post #%u", i, i);
+		gettimeofday(&end, 0);
+		usec += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+		ring.reset();
+	}
+	std::cout << "plain post: " << (usec * 1000.0) / (nrecs * nloops) << " nsec per record" << std::endl;
+}
@@ -68,6 +68,38 @@ struct burst_data {
 	unsigned int sample[4];
 };
 
+// Error record latency stats
+struct latency_stats {
+	const hogl::area       *area;
+	const hogl::timesource *ts;
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+
+	latency_stats() : area(0), ts(0), count(0), sum(0), max(0) {}
+
+	void update(const hogl::record &r)
+	{
+		if (r.area != area)
+			return;
+		uint64_t now = ts->timestamp().to_nsec(), t = r.timestamp.to_nsec();
+		uint64_t l = now > t ? now - t : 0;
+		count++;
+		sum += l;
+		if (l > max) max = l;
+	}
+
+	void dump()
+	{
+		std::cout << "Error record latency stats:" << std::endl;
+		std::cout << "\tCount: " << count << std::endl;
+		std::cout << "\tAvg:   " << (count ? sum / count : 0) << std::endl;
+		std::cout << "\tMax:   " << max << std::endl;
+	}
+};
+
+static latency_stats error_latency;
+
 // Custom format with header and footer
 class custom_format : public hogl::format_basic {
 public:
@@ -75,6 +107,12 @@ public:
 		hogl::format_basic("fast1")
 	{}
 
+	void process(hogl::ostrbuf &sb, const hogl::format::data &d)
+	{
+		hogl::format_basic::process(sb, d);
+		error_latency.update(*d.record);
+	}
+
 	void header(hogl::ostrbuf &sb, const char *n, bool first)
 	{
 		sb.printf("------- %s stress test header (this output %s) -------\n", first ? "first" : "", n);
@@ -286,6 +324,7 @@ private:
 	bool            _failed;
 
 	unsigned int    _ring_capacity;
+	unsigned int    _ring_budget;
 	unsigned int    _burst_size;
 	unsigned int    _interval_usec;
 	unsigned int    _nloops;
@@ -311,8 +350,8 @@ private:
 	static const char *_log_sections[];
 
 public:
-	test_thread(const std::string& name, unsigned int ring_capacity, unsigned int burst_size,
-				bool use_raw, bool use_blocking, bool use_cstr,
+	test_thread(const std::string& name, unsigned int ring_capacity, unsigned int ring_budget,
+				unsigned int burst_size, bool use_raw, bool use_blocking, bool use_cstr,
 				unsigned int interval_usec, unsigned int nloops, bool flush);
 	~test_thread();
 
@@ -334,14 +373,15 @@ const char *test_thread::_log_sections[] = {
 	0,
 };
 
-test_thread::test_thread(const std::string& name, unsigned int ring_capacity, unsigned int burst_size,
-	bool use_raw, bool use_blocking, bool use_cstr,
+test_thread::test_thread(const std::string& name, unsigned int ring_capacity, unsigned int ring_budget,
+	unsigned int burst_size, bool use_raw, bool use_blocking, bool use_cstr,
 	unsigned int interval_usec, unsigned int nloops, bool flush) :
 	_name(name),
 	_running(true),
 	_killed(false),
 	_failed(false),
 	_ring_capacity(ring_capacity),
+	_ring_budget(ring_budget),
 	_burst_size(burst_size),
 	_interval_usec(interval_usec),
 	_nloops(nloops),
@@ -357,6 +397,9 @@ test_thread::test_thread(const std::string& name, unsigned int ring_capacity, un
 	if (!_log_area)
 		abort();
 
+	// Must be allocated before the thread starts using it
+	_burst_data = new burst_data[_burst_size]();
+
 	err = pthread_create(&_thread, NULL, entry, (void *) this);
 	if (err) {
 		hogl::post(_log_area, INFO, "failed to create test_thread thread. %d\n", err);
@@ -365,8 +408,6 @@ test_thread::test_thread(const std::string& name, unsigned int ring_capacity, un
 
 	hogl::post(_log_area, INFO, "created test_thread %p(%s)", this, _name);
 
-	_burst_data = new burst_data[_burst_size]();
-
 	_stat_flush_timeout = 0;
 }
 
@@ -398,6 +439,7 @@ void test_thread::loop()
 	// Create private thread ring
 	hogl::ringbuf::options ring_opts = {};
 	ring_opts.capacity = _ring_capacity;
+	ring_opts.budget   = _ring_budget;
 
 	if (_use_raw)
 		ring_opts.record_tailroom = std::max((unsigned int) 256, 
@@ -476,10 +518,88 @@ void test_thread::loop()
 	_running = false;
 }
 
+// High priority thread that posts errors at a fixed rate.
+// Used for measuring error latency while other threads are flooding the engine.
+class error_thread {
+private:
+	const hogl::area *_log_area;
+	pthread_t       _thread;
+	volatile bool   _killed;
+	unsigned int    _interval_usec;
+	unsigned int    _max_latency_usec;
+
+	static void *entry(void *_self);
+	void loop();
+
+	static const char *_log_sections[];
+
+public:
+	error_thread(unsigned int interval_usec, unsigned int max_latency_usec);
+	~error_thread();
+
+	const hogl::area *area() const { return _log_area; }
+};
+
+const char *error_thread::_log_sections[] = {
+	"ERROR",
+	0,
+};
+
+error_thread::error_thread(unsigned int interval_usec, unsigned int max_latency_usec) :
+	_killed(false),
+	_interval_usec(interval_usec),
+	_max_latency_usec(max_latency_usec)
+{
+	_log_area = hogl::add_area("ERRORS", _log_sections);
+	if (!_log_area)
+		abort();
+
+	int err = pthread_create(&_thread, NULL, entry, (void *) this);
+	if (err) {
+		hogl::post(_log_area, 0, "failed to create error_thread thread. %d\n", err);
+		exit(1);
+	}
+}
+
+error_thread::~error_thread()
+{
+	_killed = true;
+	pthread_join(_thread, NULL);
+}
+
+void *error_thread::entry(void *_self)
+{
+	error_thread *self = (error_thread *) _self;
+	hogl::platform::set_thread_title("ERRORS");
+	self->loop();
+	return 0;
+}
+
+void error_thread::loop()
+{
+	hogl::ringbuf::options ring_opts = {};
+	ring_opts.capacity = 256;
+	ring_opts.prio     = 1000;
+	ring_opts.record_tailroom  = 0;
+	ring_opts.max_latency_usec = _max_latency_usec;
+
+	hogl::tls tls("ERRORS", ring_opts);
+
+	for (unsigned int n = 0; !_killed; n++) {
+		hogl::post(_log_area, 0, "error record %u", n);
+		usleep(_interval_usec);
+	}
+
+	hogl::flush();
+}
+
 // -------
 
 static unsigned int nthreads      = 8;
 static unsigned int ring_capacity = 1024;
+static unsigned int ring_budget   = 0;
+static unsigned int error_interval = 0;
+static unsigned int error_latency_usec = 0;
 static unsigned int burst_size    = 10;
 static unsigned int interval_usec = 1000;
 static unsigned int nloops        = 20000;
@@ -494,12 +614,18 @@ static output_switcher* out_switcher;
 static int doTest()
 {
 	test_thread *thread[nthreads];
+	error_thread *errors = 0;
+
+	if (error_interval) {
+		errors = new error_thread(error_interval, error_latency_usec);
+		error_latency.area = errors->area();
+	}
 
 	unsigned int i;
 	for (i=0; i < nthreads; i++) {
 		std::string name = fmt::sprintf("THREAD%u", i);
 		hogl::post(main_logarea, MAIN_INFO, "starting thread #%u (%s)", i, name);
-		thread[i] = new test_thread(name, ring_capacity, burst_size, use_raw, use_blocking, use_cstr,
+		thread[i] = new test_thread(name, ring_capacity, ring_budget, burst_size, use_raw, use_blocking, use_cstr,
 						interval_usec, nloops, i == 0 ? flush : false);
 	}
 
@@ -532,6 +658,8 @@ static int doTest()
 		delete thread[i];
 	}
 
+	delete errors;
+
 	return failed ? -1 : 0;
 }
 
@@ -585,6 +713,9 @@ static struct option main_lopts[] = {
    {"out-switch-dir",1, 0, 'D'},
    {"nthreads",    1, 0, 'n'},
    {"ring-size",   1, 0, 'r'},
+   {"ring-budget", 1, 0, 'u'},
+   {"error-interval", 1, 0, 'e'},
+   {"error-latency",  1, 0, 'L'},
    {"burst-size",  1, 0, 'b'},
    {"raw",         0, 0, 'W'},
    {"blocking",    0, 0, 'w'},
@@ -603,7 +734,7 @@ static struct option main_lopts[] = {
    {0, 0, 0, 0}
 };
 
-static char main_sopts[] = "hf:o:O:t:D:R:n:r:b:wi:l:p:N:T:A:P:S:FB:WCY:";
+static char main_sopts[] = "hf:o:O:t:D:R:n:r:u:e:L:b:wi:l:p:N:T:A:P:S:FB:WCY:";
 
 static char main_help[] =
    "HOGL stress test\n"
@@ -620,6 +751,10 @@ static char main_help[] =
       "\t--poll-interval -p <N>  Engine polling interval (in usec)\n"
       "\t--nthreads -n <N>       Number of threads to start\n"
       "\t--ring -r <N>           Ring size (number of records)\n"
+      "\t--ring-budget -u <N>    Max number of records the engine takes from each thread ring per pass\n"
+      "\t--error-interval -e <N> Start high priority thread that posts an error every N usec and\n"
+      "\t                        report error latency (custom format only)\n"
+      "\t--error-latency -L <N>  Latency target for the error thread ring (in usec)\n"
       "\t--burst-size -b <N>     Burst size (number of records)\n"
       "\t--raw -W                Use RAW records for bursting. Each record contains 'burst-size' number of entries\n"
       "\t--blocking -w           Use Blocking mode for per-thread rings\n"
@@ -684,6 +819,18 @@ int main(int argc, char *argv[])
 			ring_capacity = atoi(optarg);
 			break;
 
+		case 'u':
+			ring_budget = atoi(optarg);
+			break;
+
+		case 'e':
+			error_interval = atoi(optarg);
+			break;
+
+		case 'L':
+			error_latency_usec = atoi(optarg);
+			break;
+
 		case 'b':
 			burst_size = atoi(optarg);
 			break;
@@ -811,6 +958,13 @@ int main(int argc, char *argv[])
 	}
 
 
+	// Use the same timesource as the engine for measuring latency
+	error_latency.ts = &hogl::default_timesource;
+	if (log_eng_opts.timesource)
+		error_latency.ts = log_eng_opts.timesource;
+	if (bad_ts)
+		error_latency.ts = bad_ts;
+
 	int err = doTest();
 
 	std::cout << "Engine stats: " << std::endl;
@@ -822,6 +976,9 @@ int main(int argc, char *argv[])
 	if (log_format == "stats")
 		static_cast<stats_format *>(lf)->dump();
 
+	if (error_interval)
+		error_latency.dump();
+
 	delete out_switcher;
 
 	delete bad_ts;
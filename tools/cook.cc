@@ -129,6 +129,7 @@ static unsigned int get_version(const char *str)
 	} vm[] = {
 		{ "1.0", raw_parser::V1   },
 		{ "1.1", raw_parser::V1_1 },
+		{ "1.2", raw_parser::V1_2 },
 		{ }
 	};
 
@@ -61,6 +61,21 @@ raw_area::raw_area() : hogl::area("dummy")
 	_bitmap.resize(1);
 	_section = new const char* [1];
 	_section[0] = _section_name;
+	_name[0] = '\0';
+	_section_name[0] = '\0';
+	_last_name[0] = '\0';
+	_last_section[0] = '\0';
+	update_names();
+}
+
+void raw_area::update()
+{
+	if (!strcmp(_name, _last_name) && !strcmp(_section_name, _last_section))
+		return;
+
+	strcpy(_last_name, _name);
+	strcpy(_last_section, _section_name);
+	update_names();
 }
 
 void raw_parser::read_args(hogl::record &r)
@@ -88,7 +103,10 @@ void raw_parser::read_args(hogl::record &r)
 			r.set_arg_type(i, hogl::arg::CSTR);
 			// fall through
 		case arg::CSTR:
-			n = read_str<uint16_t>((char *) r.argval + offset, "cstr-arg");
+			if (_ver < V1_2)
+				n = read_str<uint16_t>((char *) r.argval + offset, "cstr-arg");
+			else
+				n = read_str<uint32_t>((char *) r.argval + offset, "cstr-arg");
 			r.set_arg_data(i, offset, n - 1);
 			offset += n;
 			break;
@@ -138,7 +156,9 @@ raw_parser::raw_parser(hogl::rdbuf &in, unsigned int ver, unsigned int max_recor
 	}
 
 	_format_data.ring_name = _ring_name;
+	_format_data.ring_name_len = 0; // unknown, formatter computes it
 	_format_data.record    = (hogl::record *) _record;
+	_format_data.timestamp = 0; // raw files have converted timestamps
 }
 
 raw_parser::~raw_parser()
@@ -204,6 +224,8 @@ const hogl::format::data* raw_parser::next()
 
 	if (_failed) return 0;
 
+	_area.update();
+
 	return &_format_data;
 }
 
@@ -50,11 +50,22 @@ private:
 public:
 	enum { MAX_NAME_LEN = 256 };
 
+private:
+	// Names the cached data was built for
+	char _last_name[MAX_NAME_LEN];
+	char _last_section[MAX_NAME_LEN];
+
+public:
 	raw_area();
 
 	// Overrite area methods to return non-const pointers
 	char *name()    { return _name; }
 	char *section() { return _section_name; }
+
+	// Update cached names after reading them.
+	// Names are rebuilt only when they change, which is rare
+	// since the records tend to come from the same area.
+	void update();
 };
 
 // RAW record stream parser
@@ -125,7 +136,7 @@ private:
 
 public:
 	// Compatibility versions
-	enum versions { V1, V1_1 };
+	enum versions { V1, V1_1, V1_2 };
 
 	// Constructor
 	raw_parser(hogl::rdbuf &in, unsigned int ver = V1_1, unsigned int max_record_size = 10 * 1024 * 1024);
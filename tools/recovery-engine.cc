@@ -110,6 +110,16 @@ public:
 			a->_section[i]="NA";
 		}
 
+		// Cached prefixes point into the dead process memory, rebuild them
+		a->_prefix = 0;
+		a->_prefix_off = 0;
+		a->update_names();
+
+		// Rate limits are not needed for recovery
+		a->_limit = 0;
+		if (!bitmap_validator::fixup(core, &a->_limited))
+			return 0;
+
 		return a;
 	}
 };
@@ -128,6 +138,9 @@ public:
 		ts->_name = (char *) core.remap(ts->_name);
                 if (!ts->_name)
                         return 0;
+
+		// Scale may have been in the middle of the update
+		ts->_scale_seq &= ~1u;
 		return ts;
 	}
 };
@@ -165,6 +178,14 @@ public:
 		if (!r->_name || !r->_rec_top)
 			return false;
 
+		// Limiter state and engine activity bitmap are not needed for recovery.
+		// Same goes for the arena and borrowed data, records point directly
+		// at their payload (see fixup_extern_data()).
+		r->_limiter = 0;
+		r->_activity = 0;
+		r->_arena = 0;
+		r->_borrows = false;
+
 		if (reset) {
 			// Reset head/tail for dumping the entire ring
 			r->_head = 0;
@@ -288,6 +309,34 @@ hogl::area* recovery_engine::fixup_area(const void *ptr)
 	return a;
 }
 
+// Arguments with the data outside of the record (arena, borrowed buffers)
+// hold a pointer into the crashed process. Remap it, or replace the argument
+// with a marker string if the data did not make it into the core.
+void recovery_engine::fixup_extern_data(record *r, unsigned int i)
+{
+	static const char lost[] = "(lost)";
+
+	unsigned int len = r->argval[i].data.len;
+	if (!(len & record::EXTERN_DATA))
+		return;
+	len &= ~(record::EXTERN_DATA | record::BORROWED_DATA);
+
+	uint8_t *ptr = (uint8_t *) r->argval + r->argval[i].data.offset;
+	const void *data;
+	memcpy(&data, ptr, sizeof(data));
+
+	data = _core.remap(data, len);
+	if (!data) {
+		r->set_arg_type(i, arg::CSTR);
+		data = lost;
+		len  = sizeof(lost) - 1;
+	}
+
+	// Release callbacks belong to the crashed process, drop the reference
+	memcpy(ptr, &data, sizeof(data));
+	r->argval[i].data.len = len | record::EXTERN_DATA;
+}
+
 // Validate and fixup records.
 // Things like area pointers, argument pointers, etc.
 // Note that this function fixes up areas as it goes through the records.
@@ -320,6 +369,11 @@ void recovery_engine::fixup_records(ringbuf *ring)
 				else
 					r->argval[i].u64 = (uint64_t) _core.remap((void *) r->get_arg_val64(i));
 				break;
+			case arg::CSTR:
+			case arg::RAW:
+			case arg::XDUMP:
+				fixup_extern_data(r, i);
+				break;
 			default:
 				break;
 			}
@@ -437,9 +491,17 @@ void recovery_engine::dump_records()
 	record_set::const_iterator rec_it;
 	for (rec_it = _records.begin(); rec_it != _records.end(); ++rec_it) {
 		record_entry re = *rec_it;
-		format::data d;
+
+		format::data d = {};
 		d.ring_name = re.ring->name();
+		d.ring_name_len = re.ring->name_len();
 		d.record    = re.rec;
+
+		// Convert raw timestamps using the last calibration.
+		// Conversion is monotonic and does not change the order.
+		const timesource *ts = re.ring->timesource();
+		if (ts)
+			d.timestamp = ts->convert(re.rec->timestamp);
 		_format.process(sb, d);
 	}
 
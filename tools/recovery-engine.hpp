@@ -86,6 +86,7 @@ public:
 	area* fixup_area(const void *ptr);
 	timesource* fixup_timesource(const void *ptr);
 	ostrbuf* fixup_ostrbuf(const void *ptr);
+	void fixup_extern_data(record *r, unsigned int i);
 	void fixup_records(ringbuf *ring);
 	void find_and_fixup_rings();
 	void find_and_fixup_outbufs();